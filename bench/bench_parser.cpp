@@ -0,0 +1,324 @@
+#include "lib/diff.h"
+#include "lib/document.h"
+#include "lib/omfl.h"
+#include "lib/parser.h"
+#include "lib/shared.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // [section-i] blocks with `keys` int values each.
+    std::string GenerateConfig(size_t sections, size_t keys) {
+        std::string result;
+
+        for (size_t i = 0; i < sections; ++i) {
+            result += "[section-" + std::to_string(i) + "]\n";
+
+            for (size_t j = 0; j < keys; ++j) {
+                result += "key-" + std::to_string(j) + " = " + std::to_string(i * keys + j) + "\n";
+            }
+        }
+
+        return result;
+    }
+
+    // Lines of every value type with comments and spaces in between, to exercise the scanner.
+    std::string GenerateMixedConfig(size_t sections, size_t keys) {
+        std::string result;
+
+        for (size_t i = 0; i < sections; ++i) {
+            result += "[group-" + std::to_string(i % 10) + ".section-" + std::to_string(i) + "]  # section\n";
+
+            for (size_t j = 0; j < keys; ++j) {
+                std::string key = "key-" + std::to_string(j);
+
+                switch ((i + j) % 6) {
+                    case 0:
+                        result += key + " = " + std::to_string(i * keys + j) + "\n";
+                        break;
+                    case 1:
+                        result += "  " + key + "= -" + std::to_string(j) + "." + std::to_string(i) + "\n";
+                        break;
+                    case 2:
+                        result += key + " = \"value #" + std::to_string(j) + "\"  # comment\n";
+                        break;
+                    case 3:
+                        result += key + " =" + ((j & 1) ? " true" : " false") + "\n";
+                        break;
+                    case 4:
+                        result += key + " = [1, 2.5, \"x\", [false]]\n";
+                        break;
+                    default:
+                        result += "# " + key + " = disabled\n\n";
+                        break;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // Branch mispredictions of this thread in user space, where the kernel exposes the counter.
+    class BranchMisses {
+    public:
+        BranchMisses() {
+#if defined(__linux__)
+            perf_event_attr attributes;
+
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+            attributes.disabled = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+
+            fd_ = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+        }
+
+        BranchMisses(const BranchMisses&) = delete;
+        BranchMisses& operator=(const BranchMisses&) = delete;
+
+        ~BranchMisses() {
+#if defined(__linux__)
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+#endif
+        }
+
+        template <typename Function>
+        std::optional<uint64_t> Count(Function&& function) {
+#if defined(__linux__)
+            uint64_t result = 0;
+
+            if (fd_ >= 0) {
+                ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+            }
+
+            function();
+
+            if (fd_ >= 0) {
+                ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+
+                if (read(fd_, &result, sizeof(result)) == sizeof(result)) {
+                    return result;
+                }
+            }
+#else
+            function();
+#endif
+
+            return std::nullopt;
+        }
+    private:
+        int fd_ = -1;
+    };
+
+    template <typename Function>
+    double Measure(Function&& function, size_t repeats) {
+        auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < repeats; ++i) {
+            function();
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        return elapsed.count() / repeats;
+    }
+}
+
+int main(int, char**) {
+    const std::string config = GenerateConfig(1000, 1000);
+
+    omfl::Parser root;
+    double parse_ms = Measure([&]() { root = omfl::parse(config); }, 1);
+
+    std::cout << "parse 1M items: " << parse_ms << " ms\n";
+
+    // Mispredictions per input byte of the scanner on uniform and on mixed lines.
+    const std::string mixed_config = GenerateMixedConfig(1000, 1000);
+    BranchMisses branch_misses;
+
+    for (const auto& [name, document]: {std::pair{"uniform", &config}, std::pair{"mixed", &mixed_config}}) {
+        double document_ms = 0;
+        std::optional<uint64_t> misses = branch_misses.Count([&]() {
+            document_ms = Measure([&]() { omfl::parse(*document); }, 3);
+        });
+
+        std::cout << "parse " << name << " " << document->size() / 1000000.0 / document_ms * 1000 << " MB/s, branch misses: ";
+
+        if (misses) {
+            std::cout << static_cast<double>(*misses) / document->size() << " per byte\n";
+        } else {
+            std::cout << "unavailable\n";
+        }
+    }
+
+    // Keeping one section in a thousand leaves the rest to the newline search.
+    omfl::ParseOptions filter{.sections = {"section-500"}};
+    double filtered_ms = Measure([&]() { omfl::parse(config, filter); }, 3);
+
+    std::cout << "parse keeping 1 of 1000 sections: " << config.size() / 1000000.0 / filtered_ms * 1000 << " MB/s\n";
+
+    int64_t sum = 0;
+    size_t items = 0;
+    double visit_ms = Measure([&]() {
+        root.Visit([&](const omfl::Item& item, size_t) {
+            ++items;
+
+            if (item.IsInt()) {
+                sum += item.AsInt();
+            }
+        });
+    }, 10);
+
+    std::cout << "visit " << items / 10 << " items: " << visit_ms << " ms (checksum " << sum / 10 << ")\n";
+
+    // One value changed out of 1M: the diff only descends into the section that holds it.
+    std::string changed_config = config;
+    changed_config.replace(changed_config.find("key-7 = 500007"), 14, "key-7 = 1");
+
+    omfl::Parser changed_root = omfl::parse(changed_config);
+    size_t changes = 0;
+    double diff_ms = Measure([&]() { changes += omfl::Diff(root, changed_root).changed.size(); }, 10);
+
+    std::cout << "diff 1M items, " << changes / 10 << " changed: " << diff_ms << " ms\n";
+
+    // Copies share sections; a change copies the sections on its path only.
+    double copy_ms = Measure([&]() { omfl::Parser copy = root; }, 10);
+    double set_ms = Measure([&]() {
+        omfl::Parser copy = root;
+        copy.Set("section-500.key-7", 1);
+    }, 10);
+
+    std::cout << "copy 1M items: " << copy_ms * 1000 << " us, copy and set one key: " << set_ms * 1000 << " us\n";
+
+    // Freeze copies the tree into the dense image SharedConfig publishes.
+    size_t parsed_bytes = root.MemoryUsage().Total();
+    size_t image_bytes = 0;
+    double freeze_ms = Measure([&]() { image_bytes = omfl::Freeze(root).ImageSize(); }, 1);
+
+    std::cout << "memory 1M items: " << parsed_bytes / double(config.size()) << "x source, frozen: "
+              << image_bytes / double(config.size()) << "x, freeze: " << freeze_ms << " ms\n";
+
+    // Generated configs repeat whole sections under different names.
+    std::string servers;
+
+    for (size_t i = 0; i < 100000; ++i) {
+        servers += "[servers.server-" + std::to_string(i) + "]\nenabled = true\nip = \"127.0.0.1\"\nports = [10005, 1006]\n";
+        servers += "owner = \"infrastructure-team-" + std::to_string(i % 10) + "\"\n";
+    }
+
+    omfl::ParseOptions deduplicate_options{.deduplicate = true};
+    double plain_ms = Measure([&]() { omfl::parse(servers); }, 1);
+    double deduplicate_ms = Measure([&]() { omfl::parse(servers, deduplicate_options); }, 1);
+    size_t plain_bytes = omfl::parse(servers).MemoryUsage().Total();
+    size_t deduplicated_bytes = omfl::parse(servers, deduplicate_options).MemoryUsage().Total();
+
+    std::cout << "deduplicate 100K sections: " << plain_bytes / 1e6 << " MB -> " << deduplicated_bytes / 1e6
+              << " MB, parse " << plain_ms << " ms -> " << deduplicate_ms << " ms\n";
+
+    // A patched value is spliced into the source text; the rest is copied as is.
+    double spans_ms = Measure([&]() { omfl::EditableDocument edited(config); }, 1);
+    omfl::EditableDocument edited(config);
+    double patch_ms = Measure([&]() {
+        edited.Set("section-500.key-7", 1);
+        edited.Render();
+    }, 10);
+
+    std::cout << "parse 1M items with spans: " << spans_ms << " ms, patch one value and render: " << patch_ms << " ms\n";
+
+    std::vector<std::string> tenants;
+
+    for (size_t i = 0; i < 50000; ++i) {
+        tenants.push_back(GenerateConfig(2, 5));
+    }
+
+    std::vector<std::string_view> documents(tenants.begin(), tenants.end());
+    double serial_ms = Measure([&]() {
+        for (const auto& document: tenants) {
+            omfl::parse(document);
+        }
+    }, 1);
+    double batch_ms = Measure([&]() { omfl::ParseBatch(documents); }, 1);
+    double context_ms = Measure([&]() {
+        omfl::ParserContext context;
+        omfl::Parser parser;
+
+        for (const auto& document: documents) {
+            context.Parse(document, parser);
+        }
+    }, 1);
+
+    std::cout << "serial parse: " << tenants.size() / serial_ms * 1000 << " documents/s\n";
+    std::cout << "batch parse: " << tenants.size() / batch_ms * 1000 << " documents/s\n";
+    std::cout << "reused context parse: " << tenants.size() / context_ms * 1000 << " documents/s\n";
+
+    // The same lookups through the C++ API and through the C interface.
+    const std::string lookup_config = GenerateConfig(100, 100);
+    const std::string path = "section-50.key-50";
+    constexpr size_t kLookups = 1000000;
+
+    omfl::Parser lookup_root = omfl::parse(lookup_config);
+    omfl_document* document = nullptr;
+    omfl_parse_buffer(lookup_config.data(), lookup_config.size(), &document);
+
+    int64_t cpp_sum = 0;
+    int64_t c_sum = 0;
+    double cpp_ms = Measure([&]() {
+        for (size_t i = 0; i < kLookups; ++i) {
+            cpp_sum += lookup_root.Get(path).AsInt();
+        }
+    }, 1);
+    double c_ms = Measure([&]() {
+        for (size_t i = 0; i < kLookups; ++i) {
+            int32_t value = 0;
+            omfl_get_i32(omfl_find(omfl_root(document), path.data(), path.size()), &value);
+            c_sum += value;
+        }
+    }, 1);
+
+    omfl_free(document);
+
+    std::cout << "C++ lookup: " << cpp_ms * 1e6 / kLookups << " ns (checksum " << cpp_sum << ")\n";
+    std::cout << "C API lookup: " << c_ms * 1e6 / kLookups << " ns (checksum " << c_sum << ")\n";
+
+    // Workers attach to one image per host instead of parsing their own copy.
+    const std::string shared_name = "/omfl_bench";
+    double publish_ms = Measure([&]() { omfl::SharedConfig::Publish(root, shared_name); }, 1);
+    double attach_ms = Measure([&]() { omfl::SharedConfig::Attach(shared_name); }, 10);
+
+    omfl::SharedConfig::Publish(lookup_root, shared_name);
+
+    const auto shared = omfl::SharedConfig::Attach(shared_name);
+    int64_t shared_sum = 0;
+    double shared_ms = Measure([&]() {
+        for (size_t i = 0; i < kLookups; ++i) {
+            shared_sum += shared.Get(path).AsInt();
+        }
+    }, 1);
+
+    omfl::SharedConfig::Remove(shared_name);
+
+    std::cout << "publish 1M items: " << publish_ms << " ms, attach: " << attach_ms * 1000 << " us\n";
+    std::cout << "shared lookup: " << shared_ms * 1e6 / kLookups << " ns (checksum " << shared_sum << ")\n";
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "lib/parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Parses every input family at a base size and at kScale times that size, and
+// fails when the time grows far beyond linear. A quadratic path shows up as a
+// ratio near kScale * kScale, a linear one near kScale.
+namespace {
+    constexpr size_t kScale = 8;
+    constexpr double kMaxRatio = kScale * 2.5;
+    constexpr size_t kRepeats = 5;
+
+    struct Family {
+        const char* name;
+        size_t base_size;
+        std::function<std::string(size_t)> generate;
+    };
+
+    std::string Repeat(std::string_view part, size_t count) {
+        std::string result;
+        result.reserve(part.size() * count);
+
+        for (size_t i = 0; i < count; ++i) {
+            result += part;
+        }
+
+        return result;
+    }
+
+    double BestParseTime(const std::string& input) {
+        double best = 1e18;
+
+        for (size_t i = 0; i < kRepeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            auto root = omfl::parse(input);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            best = std::min(best, elapsed.count());
+        }
+
+        return best;
+    }
+
+    const std::vector<Family> kFamilies = {
+        {"keys in one section", 4000, [](size_t n) {
+            std::string result = "[section]\n";
+
+            for (size_t i = 0; i < n; ++i) {
+                result += "key" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+            }
+
+            return result;
+        }},
+        {"sections", 2000, [](size_t n) {
+            std::string result;
+
+            for (size_t i = 0; i < n; ++i) {
+                result += "[section" + std::to_string(i) + "]\nkey = 1\n";
+            }
+
+            return result;
+        }},
+        {"deep section header", 2000, [](size_t n) {
+            return "[" + Repeat("a.", n) + "a]\nkey = 1\n";
+        }},
+        {"long key", 50000, [](size_t n) {
+            return Repeat("k", n) + " = 1\n";
+        }},
+        {"long string", 50000, [](size_t n) {
+            return "key = \"" + Repeat("x", n) + "\"\n";
+        }},
+        {"long comment", 50000, [](size_t n) {
+            return "key = 1 # " + Repeat("x", n) + "\n";
+        }},
+        {"wide array", 5000, [](size_t n) {
+            return "key = [" + Repeat("12345, \"value\", ", n) + "1]\n";
+        }},
+        {"nested arrays", 2000, [](size_t n) {
+            return "key = " + Repeat("[", n) + "1" + Repeat("]", n) + "\n";
+        }},
+    };
+}
+
+int main(int, char**) {
+    bool ok = true;
+
+    for (const auto& family: kFamilies) {
+        double small = BestParseTime(family.generate(family.base_size));
+        double large = BestParseTime(family.generate(family.base_size * kScale));
+        double ratio = large / std::max(small, 1e-3);
+        bool superlinear = ratio > kMaxRatio;
+
+        std::cout << family.name << ": " << small << " ms -> " << large << " ms, x" << ratio;
+
+        if (superlinear) {
+            std::cout << " SUPERLINEAR";
+            ok = false;
+        }
+
+        std::cout << std::endl;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#include "lib/parser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace {
+    void Touch(const omfl::Item& item) {
+        item.AsIntOrDefault(0);
+        item.AsFloatOrDefault(0);
+        item.AsStringOrDefault("");
+        item.AsBoolOrDefault(false);
+
+        if (item.IsArray() || item.IsSection()) {
+            for (const auto& child: item) {
+                Touch(child);
+            }
+        }
+
+        if (item.IsArray()) {
+            item[0];
+            item[item.Size()];
+        }
+    }
+}
+
+// The first line is a lookup path or query pattern, the rest is the document.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string_view input(reinterpret_cast<const char*>(data), size);
+    size_t line_end = input.find('\n');
+
+    if (line_end == std::string_view::npos) {
+        return 0;
+    }
+
+    std::string_view path = input.substr(0, line_end);
+    const auto root = omfl::parse(std::string(input.substr(line_end + 1)));
+
+    if (!root.valid()) {
+        return 0;
+    }
+
+    try {
+        Touch(root.Get(path));
+    } catch (const std::runtime_error&) {
+        // Missing keys and non-array indexing are reported this way.
+    }
+
+    for (const auto* item: root.Query(path)) {
+        Touch(*item);
+    }
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "lib/embedded.h"
+#include "lib/parser.h"
+#include "lib/writer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Every document that parses must survive a write/parse round trip unchanged,
+// and the compile-time parser must agree on which documents are valid.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string document(reinterpret_cast<const char*>(data), size);
+    const auto root = omfl::parse(document);
+    omfl::embedded::Draft draft;
+
+    omfl::embedded::Parse(document, draft);
+
+    if ((draft.error_line == 0) != root.valid()) {
+        __builtin_trap();
+    }
+
+    if (!root.valid()) {
+        return 0;
+    }
+
+    std::string buffer;
+    omfl::WriteToBuffer(root, buffer);
+
+    if (!(omfl::parse(buffer) == root)) {
+        __builtin_trap();
+    }
+
+    return 0;
+}
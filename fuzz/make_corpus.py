@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+# Rebuilds the seed corpus from the string literals used in tests/ and the example config.
+
+import codecs
+import hashlib
+import pathlib
+import re
+
+ROOT = pathlib.Path(__file__).resolve().parent.parent
+CORPUS = ROOT / "fuzz" / "corpus"
+QUERIES = ["common.name", "servers.*.enabled", "**.ports", "servers.first.ports", "servers.second", "*"]
+
+
+def write_seed(directory, data):
+    directory.mkdir(parents=True, exist_ok=True)
+    (directory / hashlib.sha1(data.encode()).hexdigest()).write_text(data)
+
+
+def main():
+    seeds = []
+    formats = (ROOT / "tests" / "test_format.cpp").read_text()
+
+    for block in re.findall(r"testing::Values\((.*?)\n    \)", formats, re.S):
+        for literal in re.findall(r'"((?:[^"\\]|\\.)*)"', block):
+            seeds.append(codecs.decode(literal, "unicode_escape"))
+
+    seeds += re.findall(r'R"\((.*?)\)"', (ROOT / "tests" / "test_parser.cpp").read_text(), re.S)
+
+    example = (ROOT / "example" / "config.omfl").read_text()
+    seeds.append(example)
+
+    for seed in dict.fromkeys(seeds):
+        write_seed(CORPUS / "parse", seed)
+
+    # Lookup inputs are a query line followed by the document.
+    for query in QUERIES:
+        write_seed(CORPUS / "lookup", query + "\n" + example)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,408 @@
+#include "async.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <atomic>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define OMFL_HAS_IO_URING 1
+#endif
+#endif
+
+namespace {
+    class FileRead;
+
+#ifdef OMFL_HAS_IO_URING
+    // One io_uring shared by the process. Submissions are serialized by a mutex
+    // and entered right away, and a helper thread waits for the completions.
+    class Ring {
+    public:
+        static constexpr unsigned kEntries = 64;
+
+        // Returns nullptr when the kernel does not allow io_uring.
+        static Ring* Get() {
+            static Ring* ring = []() -> Ring* {
+                auto* created = new Ring();
+
+                if (created->fd_ < 0) {
+                    delete created;
+
+                    return nullptr;
+                }
+
+                std::thread(&Ring::Reap, created).detach();
+
+                return created;
+            }();
+
+            return ring;
+        }
+
+        bool Submit(int fd, const iovec* vector, uint64_t offset, FileRead* read) {
+            std::lock_guard lock(mutex_);
+
+            unsigned tail = *sq_tail_;
+            unsigned index = tail & *sq_mask_;
+            io_uring_sqe& entry = sqes_[index];
+
+            std::memset(&entry, 0, sizeof(entry));
+            entry.opcode = IORING_OP_READV;
+            entry.fd = fd;
+            entry.addr = reinterpret_cast<uint64_t>(vector);
+            entry.len = 1;
+            entry.off = offset;
+            entry.user_data = reinterpret_cast<uint64_t>(read);
+
+            sq_array_[index] = index;
+            std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1, std::memory_order_release);
+
+            while (Enter(1, 0, 0) < 0) {
+                if (errno != EINTR) {
+                    // Take the entry back so the caller can read another way.
+                    std::atomic_ref<unsigned>(*sq_tail_).store(tail, std::memory_order_release);
+
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    private:
+        Ring() {
+            io_uring_params params{};
+
+            fd_ = syscall(__NR_io_uring_setup, kEntries, &params);
+
+            if (fd_ < 0) {
+                return;
+            }
+
+            sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+
+            sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+            cq_ring_ = Map(cq_ring_size_, IORING_OFF_CQ_RING);
+            sqes_ = static_cast<io_uring_sqe*>(Map(sqes_size_, IORING_OFF_SQES));
+
+            if (sq_ring_ == nullptr || cq_ring_ == nullptr || sqes_ == nullptr) {
+                Release();
+
+                return;
+            }
+
+            sq_tail_ = At<unsigned>(sq_ring_, params.sq_off.tail);
+            sq_mask_ = At<unsigned>(sq_ring_, params.sq_off.ring_mask);
+            sq_array_ = At<unsigned>(sq_ring_, params.sq_off.array);
+            cq_head_ = At<unsigned>(cq_ring_, params.cq_off.head);
+            cq_tail_ = At<unsigned>(cq_ring_, params.cq_off.tail);
+            cq_mask_ = At<unsigned>(cq_ring_, params.cq_off.ring_mask);
+            cqes_ = At<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+        }
+
+        ~Ring() {
+            Release();
+        }
+
+        void* Map(size_t size, off_t offset) {
+            void* result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+
+            return (result == MAP_FAILED ? nullptr : result);
+        }
+
+        template <typename T>
+        static T* At(void* ring, uint32_t offset) {
+            return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+        }
+
+        void Release() {
+            if (sq_ring_ != nullptr) {
+                munmap(sq_ring_, sq_ring_size_);
+            }
+
+            if (cq_ring_ != nullptr) {
+                munmap(cq_ring_, cq_ring_size_);
+            }
+
+            if (sqes_ != nullptr) {
+                munmap(sqes_, sqes_size_);
+            }
+
+            if (fd_ >= 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+
+        int Enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+            return syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags, nullptr, 0);
+        }
+
+        void Reap();
+
+        int fd_ = -1;
+        std::mutex mutex_;
+
+        void* sq_ring_ = nullptr;
+        void* cq_ring_ = nullptr;
+        io_uring_sqe* sqes_ = nullptr;
+        size_t sq_ring_size_ = 0;
+        size_t cq_ring_size_ = 0;
+        size_t sqes_size_ = 0;
+
+        unsigned* sq_tail_ = nullptr;
+        unsigned* sq_mask_ = nullptr;
+        unsigned* sq_array_ = nullptr;
+        unsigned* cq_head_ = nullptr;
+        unsigned* cq_tail_ = nullptr;
+        unsigned* cq_mask_ = nullptr;
+        io_uring_cqe* cqes_ = nullptr;
+    };
+#endif
+
+    // Awaitable read of a whole file. The coroutine resumes on its executor
+    // once the content is in memory.
+    class FileRead {
+    public:
+        FileRead(const std::filesystem::path& path, size_t max_bytes, omfl::Executor& executor, bool use_io_uring)
+            : path_(path)
+            , max_bytes_(max_bytes)
+            , executor_(executor)
+            , use_io_uring_(use_io_uring)
+        {}
+
+        FileRead(const FileRead&) = delete;
+        FileRead& operator=(const FileRead&) = delete;
+
+        ~FileRead() {
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+        }
+
+        bool await_ready() {
+            struct stat status;
+
+            fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+
+            if (fd_ < 0 || fstat(fd_, &status) != 0) {
+                error_ = "No such file as ";
+
+                return true;
+            }
+
+            if (static_cast<size_t>(status.st_size) > max_bytes_) {
+                too_large_ = true;
+
+                return true;
+            }
+
+            content_.resize(status.st_size);
+
+            return content_.empty();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+
+#ifdef OMFL_HAS_IO_URING
+            if (use_io_uring_ && Ring::Get() != nullptr && SubmitNext()) {
+                return;
+            }
+#endif
+
+            ReadOnThread();
+        }
+
+        // nullopt when the file is larger than allowed.
+        std::optional<std::string> await_resume() {
+            if (!error_.empty()) {
+                throw std::runtime_error(error_ + path_.filename().string());
+            }
+
+            if (too_large_) {
+                return std::nullopt;
+            }
+
+            return std::move(content_);
+        }
+
+#ifdef OMFL_HAS_IO_URING
+        void Complete(int result) {
+            if (result == -EINTR || result == -EAGAIN) {
+                if (!SubmitNext()) {
+                    ReadOnThread();
+                }
+
+                return;
+            }
+
+            if (result < 0) {
+                // Kernels without vectored reads on the ring end up here too.
+                ReadOnThread();
+
+                return;
+            }
+
+            done_ += result;
+
+            if (result == 0) {
+                // The file shrank since it was opened.
+                content_.resize(done_);
+            } else if (done_ < content_.size()) {
+                if (!SubmitNext()) {
+                    ReadOnThread();
+                }
+
+                return;
+            }
+
+            executor_.Post(handle_);
+        }
+#endif
+    private:
+#ifdef OMFL_HAS_IO_URING
+        bool SubmitNext() {
+            vector_.iov_base = content_.data() + done_;
+            vector_.iov_len = content_.size() - done_;
+
+            return Ring::Get()->Submit(fd_, &vector_, done_, this);
+        }
+#endif
+
+        void ReadOnThread() {
+            std::thread([this]() {
+                while (done_ < content_.size()) {
+                    ssize_t result = pread(fd_, content_.data() + done_, content_.size() - done_, done_);
+
+                    if (result < 0 && errno == EINTR) {
+                        continue;
+                    }
+
+                    if (result < 0) {
+                        error_ = "Failed to read ";
+
+                        break;
+                    }
+
+                    if (result == 0) {
+                        content_.resize(done_);
+
+                        break;
+                    }
+
+                    done_ += result;
+                }
+
+                executor_.Post(handle_);
+            }).detach();
+        }
+
+        std::filesystem::path path_;
+        size_t max_bytes_;
+        omfl::Executor& executor_;
+        bool use_io_uring_;
+
+        int fd_ = -1;
+        std::string content_;
+        size_t done_ = 0;
+        iovec vector_{};
+        std::string error_;
+        bool too_large_ = false;
+        std::coroutine_handle<> handle_;
+    };
+
+#ifdef OMFL_HAS_IO_URING
+    void Ring::Reap() {
+        while (true) {
+            if (Enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                return;
+            }
+
+            unsigned head = std::atomic_ref<unsigned>(*cq_head_).load(std::memory_order_relaxed);
+            unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+
+            for (; head != tail; ++head) {
+                const io_uring_cqe& completion = cqes_[head & *cq_mask_];
+                auto* read = reinterpret_cast<FileRead*>(completion.user_data);
+                int result = completion.res;
+
+                // The read may be destroyed as soon as it completes, so the slot is released first.
+                std::atomic_ref<unsigned>(*cq_head_).store(head + 1, std::memory_order_release);
+                read->Complete(result);
+            }
+        }
+    }
+#endif
+
+    // Reschedules the awaiting coroutine behind whatever else the executor has queued.
+    struct YieldTo {
+        omfl::Executor& executor;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            executor.Post(handle);
+        }
+
+        void await_resume() const noexcept {}
+    };
+}
+
+void omfl::LocalExecutor::Post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(handle);
+    }
+
+    ready_.notify_one();
+}
+
+std::coroutine_handle<> omfl::LocalExecutor::Pop() {
+    std::unique_lock lock(mutex_);
+
+    ready_.wait(lock, [this]() {
+        return !queue_.empty();
+    });
+
+    std::coroutine_handle<> handle = queue_.front();
+    queue_.pop_front();
+
+    return handle;
+}
+
+omfl::Task<omfl::Parser> omfl::ParseAsync(std::filesystem::path path, Executor& executor, ParseOptions options, AsyncOptions async_options) {
+    std::optional<std::string> content = co_await FileRead(path, options.limits.max_bytes, executor, async_options.use_io_uring);
+    Parser parser;
+
+    if (!content) {
+        parser.MarkUnsuccessful();
+
+        co_return parser;
+    }
+
+    ParserContext context;
+
+    context.Begin(*content, parser, options, path);
+
+    while (!context.Resume(std::max<size_t>(1, async_options.yield_bytes))) {
+        co_await YieldTo{executor};
+    }
+
+    co_return parser;
+}
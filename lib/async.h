@@ -0,0 +1,156 @@
+#pragma once
+
+#include "parser.h"
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace omfl {
+    // Resumes coroutines on behalf of an event loop. Post may be called from any thread.
+    class Executor {
+    public:
+        virtual ~Executor() = default;
+
+        virtual void Post(std::coroutine_handle<> handle) = 0;
+    };
+
+    // Lazily started coroutine producing a T. Awaiting it starts it, and the
+    // awaiting coroutine continues once it finishes.
+    template <typename T>
+    class Task {
+    public:
+        struct promise_type {
+            std::optional<T> value;
+            std::exception_ptr exception;
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+
+            Task get_return_object() {
+                return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            auto final_suspend() noexcept {
+                struct Continue {
+                    bool await_ready() noexcept {
+                        return false;
+                    }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                        return handle.promise().continuation;
+                    }
+
+                    void await_resume() noexcept {}
+                };
+
+                return Continue{};
+            }
+
+            void return_value(T result) {
+                value.emplace(std::move(result));
+            }
+
+            void unhandled_exception() {
+                exception = std::current_exception();
+            }
+        };
+
+        Task(Task&& other) noexcept
+            : handle_(std::exchange(other.handle_, nullptr))
+        {}
+
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                Reset();
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~Task() {
+            Reset();
+        }
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle_.promise().continuation = awaiting;
+
+            return handle_;
+        }
+
+        T await_resume() {
+            return TakeResult();
+        }
+    private:
+        friend class LocalExecutor;
+
+        explicit Task(std::coroutine_handle<promise_type> handle)
+            : handle_(handle)
+        {}
+
+        void Reset() {
+            if (handle_) {
+                handle_.destroy();
+            }
+        }
+
+        T TakeResult() {
+            if (handle_.promise().exception) {
+                std::rethrow_exception(handle_.promise().exception);
+            }
+
+            return std::move(*handle_.promise().value);
+        }
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    // Executor drained by the thread that calls Run, for tests and simple programs.
+    class LocalExecutor : public Executor {
+    public:
+        void Post(std::coroutine_handle<> handle) override;
+
+        // Runs `task` and everything it posts until the task completes, waiting
+        // for posts from other threads while there is nothing to resume.
+        template <typename T>
+        T Run(Task<T> task) {
+            Post(task.handle_);
+
+            while (!task.handle_.done()) {
+                Pop().resume();
+            }
+
+            return task.TakeResult();
+        }
+    private:
+        std::coroutine_handle<> Pop();
+
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<std::coroutine_handle<>> queue_;
+    };
+
+    struct AsyncOptions {
+        // Parsing goes back to the executor after about this many bytes.
+        size_t yield_bytes = 64 * 1024;
+        // Reads through io_uring when the kernel allows it, on a helper thread otherwise.
+        bool use_io_uring = true;
+    };
+
+    // Reads and parses a file without blocking the executor: the read completes
+    // off-thread and the parse yields between chunks. Included files, if enabled,
+    // are still read synchronously. A missing file is reported when awaited.
+    Task<Parser> ParseAsync(std::filesystem::path path, Executor& executor, ParseOptions options = {}, AsyncOptions async_options = {});
+}
@@ -0,0 +1,202 @@
+#include "omfl.h"
+#include "parser.h"
+
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+struct omfl_document {
+    omfl::Parser parser;
+};
+
+namespace {
+    // NULL, as returned by a failed omfl_find or omfl_at, stands for an
+    // undefined item, so that lookups can be chained into the getters.
+    const omfl::Item& Unwrap(const omfl_item* item) {
+        static const omfl::Item undefined("", omfl::Value(), omfl::Type::Undefined);
+
+        return (item == nullptr ? undefined : *reinterpret_cast<const omfl::Item*>(item));
+    }
+
+    const omfl_item* Wrap(const omfl::Item* item) {
+        return reinterpret_cast<const omfl_item*>(item);
+    }
+
+    omfl_string MakeString(std::string_view view) {
+        return {view.data(), view.size()};
+    }
+
+    omfl_status Finish(std::unique_ptr<omfl_document> result, omfl_document** document) {
+        if (!result->parser.valid()) {
+            return OMFL_INVALID;
+        }
+
+        *document = result.release();
+
+        return OMFL_OK;
+    }
+}
+
+uint32_t omfl_abi_version(void) {
+    return OMFL_ABI_VERSION;
+}
+
+omfl_status omfl_parse_buffer(const char* data, size_t size, omfl_document** document) {
+    *document = nullptr;
+
+    try {
+        auto result = std::make_unique<omfl_document>();
+        omfl::ParserContext context;
+
+        context.Parse(std::string_view(data, size), result->parser);
+
+        return Finish(std::move(result), document);
+    } catch (const std::bad_alloc&) {
+        return OMFL_NO_MEMORY;
+    } catch (...) {
+        return OMFL_INVALID;
+    }
+}
+
+omfl_status omfl_parse_file(const char* path, omfl_document** document) {
+    *document = nullptr;
+
+    try {
+        auto result = std::make_unique<omfl_document>();
+
+        result->parser = omfl::parse(std::filesystem::path(path));
+
+        return Finish(std::move(result), document);
+    } catch (const std::bad_alloc&) {
+        return OMFL_NO_MEMORY;
+    } catch (...) {
+        return OMFL_IO_ERROR;
+    }
+}
+
+void omfl_free(omfl_document* document) {
+    delete document;
+}
+
+const omfl_item* omfl_root(const omfl_document* document) {
+    return Wrap(&document->parser.GetRoot());
+}
+
+const omfl_item* omfl_find(const omfl_item* section, const char* path, size_t path_size) {
+    return Wrap(Unwrap(section).Find(std::string_view(path, path_size)));
+}
+
+omfl_type omfl_item_type(const omfl_item* item) {
+    return static_cast<omfl_type>(Unwrap(item).GetType());
+}
+
+omfl_string omfl_item_key(const omfl_item* item) {
+    return MakeString(Unwrap(item).GetKey());
+}
+
+int omfl_get_i32(const omfl_item* item, int32_t* value) {
+    const auto* result = std::get_if<int32_t>(&Unwrap(item).GetValue());
+
+    if (result == nullptr) {
+        return 0;
+    }
+
+    *value = *result;
+
+    return 1;
+}
+
+int omfl_get_f64(const omfl_item* item, double* value) {
+    const auto* result = std::get_if<double>(&Unwrap(item).GetValue());
+
+    if (result == nullptr) {
+        return 0;
+    }
+
+    *value = *result;
+
+    return 1;
+}
+
+int omfl_get_bool(const omfl_item* item, int* value) {
+    const auto* result = std::get_if<bool>(&Unwrap(item).GetValue());
+
+    if (result == nullptr) {
+        return 0;
+    }
+
+    *value = *result;
+
+    return 1;
+}
+
+int omfl_get_str(const omfl_item* item, omfl_string* value) {
+    const auto* result = std::get_if<std::string>(&Unwrap(item).GetValue());
+
+    if (result == nullptr) {
+        return 0;
+    }
+
+    *value = MakeString(*result);
+
+    return 1;
+}
+
+size_t omfl_size(const omfl_item* item) {
+    const omfl::Item& unwrapped = Unwrap(item);
+
+    return (unwrapped.IsArray() || unwrapped.IsSection() ? unwrapped.Size() : 0);
+}
+
+const omfl_item* omfl_at(const omfl_item* item, size_t index) {
+    const omfl::Item& unwrapped = Unwrap(item);
+
+    if (!(unwrapped.IsArray() || unwrapped.IsSection()) || index >= unwrapped.Size()) {
+        return nullptr;
+    }
+
+    try {
+        // Packed arrays build their element Items on first access, which may allocate.
+        return Wrap(unwrapped.begin() + index);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+int omfl_get_i32_array(const omfl_item* item, const int32_t** data, size_t* size) {
+    const auto* array = std::get_if<omfl::ValueArray>(&Unwrap(item).GetValue());
+
+    if (array == nullptr) {
+        return 0;
+    }
+
+    try {
+        std::span<const int32_t> values = array->AsIntSpan();
+
+        *data = values.data();
+        *size = values.size();
+
+        return 1;
+    } catch (const std::runtime_error&) {
+        return 0;
+    }
+}
+
+int omfl_get_f64_array(const omfl_item* item, const double** data, size_t* size) {
+    const auto* array = std::get_if<omfl::ValueArray>(&Unwrap(item).GetValue());
+
+    if (array == nullptr) {
+        return 0;
+    }
+
+    try {
+        std::span<const double> values = array->AsFloatSpan();
+
+        *data = values.data();
+        *size = values.size();
+
+        return 1;
+    } catch (const std::runtime_error&) {
+        return 0;
+    }
+}
@@ -0,0 +1,112 @@
+#include "diff.h"
+
+namespace {
+    // Appends the keys of all values at or below item, which is found at path.
+    void CollectKeys(const omfl::Item& item, const std::string& path, std::vector<std::string>& result) {
+        if (!item.IsSection()) {
+            result.push_back(path);
+
+            return;
+        }
+
+        std::vector<std::pair<const omfl::Item*, std::string>> pending = {{&item, path}};
+
+        while (!pending.empty()) {
+            auto [section, prefix] = std::move(pending.back());
+            pending.pop_back();
+
+            for (const auto& child: *section) {
+                std::string child_path = prefix + '.' + child.GetKey();
+
+                if (child.IsSection()) {
+                    pending.emplace_back(&child, std::move(child_path));
+                } else {
+                    result.push_back(std::move(child_path));
+                }
+            }
+        }
+    }
+}
+
+bool omfl::DocumentDiff::Empty() const {
+    return added.empty() && removed.empty() && changed.empty();
+}
+
+omfl::DocumentDiff omfl::Diff(const Parser& before, const Parser& after) {
+    DocumentDiff result;
+
+    // Pairs of sections with different hashes, and the path leading to them.
+    std::vector<std::pair<const Item*, const Item*>> sections;
+    std::vector<std::string> paths;
+
+    if (before.GetRoot().Hash() != after.GetRoot().Hash()) {
+        sections.emplace_back(&before.GetRoot(), &after.GetRoot());
+        paths.emplace_back();
+    }
+
+    while (!sections.empty()) {
+        auto [old_section, new_section] = sections.back();
+        std::string prefix = std::move(paths.back());
+
+        sections.pop_back();
+        paths.pop_back();
+
+        if (!prefix.empty()) {
+            prefix += '.';
+        }
+
+        const auto& old_items = std::get<SectionTable>(old_section->GetValue());
+        size_t position = 0;
+        size_t matched = 0;
+
+        for (const auto& item: *new_section) {
+            ++result.compared;
+
+            // Children usually keep their positions, which saves the lookup.
+            const Item* old_item = (position < old_items.Size() && old_items.begin()[position].GetKey() == item.GetKey()
+                ? old_items.begin() + position
+                : old_items.Find(item.GetKey()));
+
+            ++position;
+
+            if (old_item != nullptr) {
+                ++matched;
+
+                if (old_item->Hash() == item.Hash()) {
+                    continue;
+                }
+            }
+
+            std::string path = prefix + item.GetKey();
+
+            if (old_item == nullptr) {
+                CollectKeys(item, path, result.added);
+            } else if (old_item->IsSection() && item.IsSection()) {
+                sections.emplace_back(old_item, &item);
+                paths.push_back(std::move(path));
+            } else if (old_item->IsSection() || item.IsSection()) {
+                CollectKeys(*old_item, path, result.removed);
+                CollectKeys(item, path, result.added);
+            } else {
+                result.changed.push_back(std::move(path));
+            }
+        }
+
+        // Keys are unique, so nothing was removed when every old key was matched.
+        if (matched == old_items.Size()) {
+            continue;
+        }
+
+        const auto& new_items = std::get<SectionTable>(new_section->GetValue());
+
+        for (const auto& old_item: *old_section) {
+            ++result.compared;
+
+            if (new_items.Find(old_item.GetKey()) == nullptr) {
+                CollectKeys(old_item, prefix + old_item.GetKey(), result.removed);
+            }
+        }
+    }
+
+    return result;
+}
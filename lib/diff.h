@@ -0,0 +1,28 @@
+#pragma once
+
+#include "parser.h"
+
+#include <string>
+#include <vector>
+
+namespace omfl {
+    // Fully qualified keys of the values that differ between two documents.
+    // A section turning into a value, or the other way round, removes the old
+    // keys and adds the new ones.
+    struct DocumentDiff {
+        std::vector<std::string> added;
+        std::vector<std::string> removed;
+        std::vector<std::string> changed;
+        // Children of differing sections that Diff looked at, see Diff.
+        size_t compared = 0;
+
+        bool Empty() const;
+    };
+
+    // Compares sections by their hashes first and descends only into those
+    // that differ. Subtrees with equal hashes are taken as equal. Every child
+    // of a differing section is still compared, so the time taken is
+    // O(width of the sections along the changed paths), not of the change:
+    // one changed key in a flat section of N keys costs N comparisons.
+    DocumentDiff Diff(const Parser& before, const Parser& after);
+}
@@ -0,0 +1,110 @@
+#include "document.h"
+#include "writer.h"
+
+#include <stdexcept>
+
+omfl::EditableDocument::EditableDocument(std::string source, const ParseOptions& options)
+    : source_(std::move(source))
+    , parser_(ParseWithSpans(source_, spans_, options))
+{
+    positions_.reserve(spans_.size());
+
+    for (size_t i = 0; i < spans_.size(); ++i) {
+        positions_.emplace(spans_[i].path, i);
+    }
+}
+
+bool omfl::EditableDocument::valid() const {
+    return parser_.valid();
+}
+
+const omfl::Parser& omfl::EditableDocument::GetParser() const {
+    return parser_;
+}
+
+const std::string& omfl::EditableDocument::GetSource() const {
+    return source_;
+}
+
+const omfl::EntrySpans* omfl::EditableDocument::FindSpans(std::string_view name) const {
+    auto position = positions_.find(std::string(name));
+
+    return (position == positions_.end() ? nullptr : &spans_[position->second]);
+}
+
+void omfl::EditableDocument::Set(std::string_view name, Value value) {
+    const EntrySpans& spans = GetSpans(name);
+    Type type = static_cast<Type>(value.index());
+
+    if (type == Type::Undefined || type == Type::Section) {
+        throw std::runtime_error("Only plain values can be set.");
+    }
+
+    std::string text;
+
+    WriteValue(Item(spans.path, value, type), text);
+    parser_.Set(name, std::move(value));
+    edits_[spans.value.begin] = Edit{spans.value, std::move(text)};
+}
+
+void omfl::EditableDocument::SetComment(std::string_view name, std::string_view comment) {
+    const EntrySpans& spans = GetSpans(name);
+
+    if (comment.find('\n') != std::string_view::npos) {
+        throw std::runtime_error("Comment cannot span several lines.");
+    }
+
+    // The edit starts at the end of the value, so that clearing a comment
+    // also drops the spaces before it.
+    SourceSpan span{spans.value.end, spans.comment.end};
+    std::string text;
+
+    if (!comment.empty()) {
+        // A new comment is set apart from the value by two spaces, a replaced one keeps its spacing.
+        if (spans.comment.begin == spans.comment.end) {
+            text = "  ";
+        } else {
+            text = source_.substr(span.begin, spans.comment.begin - span.begin);
+        }
+
+        text += "# ";
+        text += comment;
+    }
+
+    edits_[span.begin] = Edit{span, std::move(text)};
+}
+
+size_t omfl::EditableDocument::EditCount() const {
+    return edits_.size();
+}
+
+std::string omfl::EditableDocument::Render() const {
+    std::string result;
+    size_t position = 0;
+
+    result.reserve(source_.size());
+
+    for (const auto& [begin, edit]: edits_) {
+        result.append(source_, position, begin - position);
+        result += edit.text;
+        position = edit.span.end;
+    }
+
+    result.append(source_, position);
+
+    return result;
+}
+
+const omfl::EntrySpans& omfl::EditableDocument::GetSpans(std::string_view name) const {
+    if (!valid()) {
+        throw std::runtime_error("Document is invalid.");
+    }
+
+    const EntrySpans* spans = FindSpans(name);
+
+    if (spans == nullptr) {
+        throw std::runtime_error("Key is not written in the document: " + std::string(name));
+    }
+
+    return *spans;
+}
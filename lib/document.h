@@ -0,0 +1,72 @@
+#pragma once
+
+#include "parser.h"
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace omfl {
+    // Bytes [begin, end) of a source.
+    struct SourceSpan {
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    // Where a `key = value  # comment` line sits in its source. A line without
+    // a comment has an empty comment span right after the value.
+    struct EntrySpans {
+        std::string path;
+        SourceSpan key;
+        SourceSpan value;
+        SourceSpan comment;
+    };
+
+    // Parses like omfl::parse, also appending the spans of every value that
+    // comes from str itself, as opposed to an included file.
+    Parser ParseWithSpans(std::string_view str, std::vector<EntrySpans>& spans, const ParseOptions& options = {});
+
+    // A document edited in place: edits replace the spans of the values and
+    // comments they touch, and everything else is kept byte for byte.
+    class EditableDocument {
+    public:
+        explicit EditableDocument(std::string source, const ParseOptions& options = {});
+
+        bool valid() const;
+
+        // The values with all edits so far applied.
+        const Parser& GetParser() const;
+        const std::string& GetSource() const;
+        // Spans in the source as it was parsed, nullptr for keys not written in it.
+        const EntrySpans* FindSpans(std::string_view name) const;
+
+        // Replaces the value of a key written in the source. The value is
+        // formatted as by omfl::Write; sections cannot be set.
+        void Set(std::string_view name, Value value);
+        // Replaces the comment after the value of a key, or adds one. The text
+        // goes after "# ", and an empty text removes the comment.
+        void SetComment(std::string_view name, std::string_view comment);
+
+        size_t EditCount() const;
+
+        // The source with the edits spliced in, in a single pass over it.
+        std::string Render() const;
+    private:
+        struct Edit {
+            SourceSpan span;
+            std::string text;
+        };
+
+        const EntrySpans& GetSpans(std::string_view name) const;
+
+        std::string source_;
+        std::vector<EntrySpans> spans_;
+        Parser parser_;
+        // Owns its keys, so that copies of the document stay independent.
+        std::unordered_map<std::string, size_t> positions_;
+        // Keyed by where they start, which is the order Render applies them in.
+        std::map<size_t, Edit> edits_;
+    };
+}
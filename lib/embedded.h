@@ -0,0 +1,586 @@
+#pragma once
+
+#include "grammar.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cinttypes>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace omfl {
+    // String literal usable as a template argument, as in omfl::Embed<R"(...)">().
+    template <size_t N>
+    struct Literal {
+        constexpr Literal(const char (&text)[N]) {
+            std::copy_n(text, N, data);
+        }
+
+        constexpr std::string_view View() const {
+            return std::string_view(data, N - 1);
+        }
+
+        char data[N];
+    };
+
+    // Parsing of documents compiled into the program. The document is read by
+    // the compiler: an invalid one, a lookup of a missing key or a value of the
+    // wrong type fail the build. The rules follow omfl::parse, except that
+    // includes are not available.
+    namespace embedded {
+        struct Node {
+            Type type = Type::Undefined;
+            int32_t integer = 0;
+            double floating = 0;
+            bool boolean = false;
+            // Text of a string in the source, or the elements of an array in the node pool.
+            size_t begin = 0;
+            size_t size = 0;
+        };
+
+        // A value with its section header and key, both kept as positions in the source.
+        struct Entry {
+            size_t section_begin = 0;
+            size_t section_size = 0;
+            size_t key_begin = 0;
+            size_t key_size = 0;
+            Node value;
+        };
+
+        // Result of Parse, before it is copied into storage of a fixed size.
+        struct Draft {
+            std::vector<Entry> entries;
+            std::vector<Node> nodes;
+            std::vector<std::string> paths;
+            // Line of the first error, 0 while the document is valid.
+            size_t error_line = 0;
+        };
+
+        // Not constexpr, so that reaching them while compiling is reported as an error.
+        inline void EmbeddedDocumentIsInvalid(size_t line) {
+            throw std::runtime_error("Embedded document is invalid at line " + std::to_string(line) + ".");
+        }
+
+        inline void EmbeddedKeyIsMissing() {
+            throw std::runtime_error("Addressing to an non-existing key/section.");
+        }
+
+        inline void FloatNeedsRuntimeConversion() {
+            throw std::runtime_error("Float cannot be rounded exactly while compiling.");
+        }
+
+        constexpr std::string_view Trim(std::string_view text) {
+            size_t begin = text.find_first_not_of(' ');
+
+            if (begin == std::string_view::npos) {
+                return text.substr(0, 0);
+            }
+
+            return text.substr(begin, text.find_last_not_of(' ') + 1 - begin);
+        }
+
+        // Same result as std::from_chars in the fixed format. While compiling only
+        // values with at most 2^53 as digits and 22 decimals are converted, as both
+        // parts are then exact doubles and a single division rounds correctly.
+        constexpr bool ConvertFloat(std::string_view text, double& result) {
+            if (!std::is_constant_evaluated()) {
+                auto [position, error] = std::from_chars(text.data(), text.data() + text.size(), result, std::chars_format::fixed);
+
+                return error == std::errc() && position == text.data() + text.size();
+            }
+
+            constexpr uint64_t kExactLimit = uint64_t(1) << 53;
+
+            bool negative = (text[0] == '-');
+            uint64_t digits = 0;
+            size_t decimals = 0;
+            bool point_seen = false;
+
+            if (negative) {
+                text.remove_prefix(1);
+            }
+
+            // Trailing zeros of the fraction do not change the value.
+            while (text.find('.') != std::string_view::npos && text.back() == '0') {
+                text.remove_suffix(1);
+            }
+
+            for (char character: text) {
+                if (character == '.') {
+                    point_seen = true;
+
+                    continue;
+                }
+
+                uint64_t digit = character - '0';
+
+                if (digits > (kExactLimit - digit) / 10) {
+                    FloatNeedsRuntimeConversion();
+                }
+
+                digits = digits * 10 + digit;
+                decimals += point_seen;
+            }
+
+            if (decimals > 22) {
+                FloatNeedsRuntimeConversion();
+            }
+
+            double power = 1;
+
+            for (size_t i = 0; i < decimals; ++i) {
+                power *= 10;
+            }
+
+            result = static_cast<double>(digits) / power;
+
+            if (negative) {
+                result = -result;
+            }
+
+            return true;
+        }
+
+        constexpr bool ConvertInt(std::string_view text, int32_t& result) {
+            bool negative = (text[0] == '-');
+            int64_t value = 0;
+
+            if (negative) {
+                text.remove_prefix(1);
+            }
+
+            for (char character: text) {
+                value = value * 10 + (character - '0');
+
+                if (value > int64_t(std::numeric_limits<int32_t>::max()) + negative) {
+                    return false;
+                }
+            }
+
+            result = static_cast<int32_t>(negative ? -value : value);
+
+            return true;
+        }
+
+        // Converts a value already classified by GetValueType, as ConvertValue does.
+        constexpr bool ConvertScalar(std::string_view source, std::string_view text, Type type, Node& node) {
+            node.type = type;
+
+            if (type == Type::Integer || type == Type::Float) {
+                if (text[0] == '+') {
+                    text.remove_prefix(1);
+                }
+
+                return type == Type::Integer ? ConvertInt(text, node.integer) : ConvertFloat(text, node.floating);
+            } else if (type == Type::String) {
+                node.begin = text.data() - source.data() + 1;
+                node.size = text.size() - 2;
+            } else {
+                node.boolean = (text == "true");
+            }
+
+            return true;
+        }
+
+        // Follows ConstructValueArray. Elements of an array are moved to the node
+        // pool together once it is closed, so that they stay contiguous.
+        constexpr bool ConvertArray(std::string_view source, std::string_view value, Draft& draft, Node& result) {
+            std::vector<std::vector<Node>> arrays;
+            size_t element_begin = 0;
+            bool nested_closed = false;
+            bool in_string = false;
+
+            for (size_t i = 0; i < value.size(); ++i) {
+                char character = value[i];
+                std::string_view element = value.substr(element_begin, i - element_begin);
+
+                if (in_string) {
+                    in_string = (character != '\"');
+
+                    continue;
+                }
+
+                if (character == '[') {
+                    if (nested_closed || element.find_first_not_of(' ') != std::string_view::npos) {
+                        return false;
+                    }
+
+                    arrays.emplace_back();
+                    element_begin = i + 1;
+                } else if (character == ',' || character == ']') {
+                    // Elements with no text at all are skipped, blank ones are rejected.
+                    if (!nested_closed && !element.empty()) {
+                        element = Trim(element);
+
+                        Type type = grammar::GetValueType(element);
+                        Node node;
+
+                        if (type == Type::Undefined || type == Type::Array || !ConvertScalar(source, element, type, node)) {
+                            return false;
+                        }
+
+                        arrays.back().push_back(node);
+                    }
+
+                    element_begin = i + 1;
+                    nested_closed = false;
+
+                    if (character == ']') {
+                        Node array;
+
+                        array.type = Type::Array;
+                        array.begin = draft.nodes.size();
+                        array.size = arrays.back().size();
+                        draft.nodes.insert(draft.nodes.end(), arrays.back().begin(), arrays.back().end());
+                        arrays.pop_back();
+
+                        if (arrays.empty()) {
+                            result = array;
+
+                            return i + 1 == value.size();
+                        }
+
+                        arrays.back().push_back(array);
+                        nested_closed = true;
+                    }
+                } else if (nested_closed) {
+                    if (character != ' ') {
+                        return false;
+                    }
+
+                    element_begin = i + 1;
+                } else {
+                    in_string = (character == '\"');
+                }
+            }
+
+            return false;
+        }
+
+        // A key and a subsection cannot share a name, nor can two keys.
+        constexpr bool Collides(std::string_view lhs, std::string_view rhs) {
+            if (lhs.size() > rhs.size()) {
+                std::swap(lhs, rhs);
+            }
+
+            return rhs.starts_with(lhs) && (rhs.size() == lhs.size() || rhs[lhs.size()] == '.');
+        }
+
+        constexpr bool Update(std::string_view source, std::string_view section, std::string_view key, std::string_view value, Draft& draft) {
+            key = Trim(key);
+            value = Trim(value);
+
+            if (key.empty() && value.empty()) {
+                return true;
+            }
+
+            if (!grammar::CheckKeyValidity(key)) {
+                return false;
+            }
+
+            Type type = grammar::GetValueType(value);
+            Entry entry;
+
+            if (type == Type::Undefined) {
+                return false;
+            }
+
+            if (type == Type::Array ? !ConvertArray(source, value, draft, entry.value) : !ConvertScalar(source, value, type, entry.value)) {
+                return false;
+            }
+
+            std::string path(section);
+
+            if (!path.empty()) {
+                path.push_back('.');
+            }
+
+            path.append(key);
+
+            for (const auto& other: draft.paths) {
+                if (Collides(path, other)) {
+                    return false;
+                }
+            }
+
+            entry.section_begin = section.data() - source.data();
+            entry.section_size = section.size();
+            entry.key_begin = key.data() - source.data();
+            entry.key_size = key.size();
+            draft.entries.push_back(entry);
+            draft.paths.push_back(std::move(path));
+
+            return true;
+        }
+
+        // Follows ParseSections. On success header holds the dotted path between the brackets.
+        constexpr bool ParseSections(std::string_view source, size_t& index, std::string_view& header) {
+            size_t header_begin = index;
+            size_t name_begin = index;
+            bool closed = false;
+            bool ok = true;
+
+            for (; index < source.size() && source[index] != '\n' && !closed; ++index) {
+                if (source[index] == '.' || source[index] == ']') {
+                    ok &= grammar::CheckKeyValidity(source.substr(name_begin, index - name_begin));
+                    name_begin = index + 1;
+                    closed = (source[index] == ']');
+                }
+            }
+
+            header = source.substr(header_begin, index - header_begin - closed);
+
+            size_t line_end = std::min(source.find('\n', index), source.size());
+            std::string_view rest = source.substr(index, line_end - index);
+            size_t rest_begin = rest.find_first_not_of(' ');
+
+            index = line_end;
+
+            return ok && closed && (rest_begin == std::string_view::npos || rest[rest_begin] == '#');
+        }
+
+        // Drives the line scanner of ParseRange with the default options. Keys
+        // and values are contiguous in the source, so they are kept as views into it.
+        constexpr void Parse(std::string_view source, Draft& draft) {
+            std::string_view section = source.substr(0, 0);
+            size_t key_begin = 0;
+            size_t key_size = 0;
+            size_t value_begin = 0;
+            size_t value_size = 0;
+            size_t line = 1;
+            grammar::ScanState state = grammar::ScanState::Key;
+
+            for (size_t index = 0; index < source.size(); ++index) {
+                grammar::ScanStep step = grammar::Scan(state, source[index]);
+                bool ok = true;
+
+                state = step.next;
+
+                switch (step.action) {
+                    case grammar::ScanAction::Skip:
+                        break;
+                    case grammar::ScanAction::Include:
+                    case grammar::ScanAction::AppendKey:
+                        key_begin = (key_size == 0 ? index : key_begin);
+                        ++key_size;
+
+                        break;
+                    case grammar::ScanAction::AppendValue:
+                        value_begin = (value_size == 0 ? index : value_begin);
+                        ++value_size;
+
+                        break;
+                    case grammar::ScanAction::EndLine:
+                        ok = Update(source, section, source.substr(key_begin, key_size), source.substr(value_begin, value_size), draft);
+
+                        break;
+                    case grammar::ScanAction::Header:
+                        // The newline after the header is skipped along with it.
+                        ok = ParseSections(source, ++index, section);
+
+                        break;
+                    case grammar::ScanAction::Fail:
+                        ok = false;
+
+                        break;
+                }
+
+                if (!ok) {
+                    draft.error_line = line;
+
+                    return;
+                }
+
+                if (step.action == grammar::ScanAction::EndLine || step.action == grammar::ScanAction::Header) {
+                    ++line;
+                    key_size = 0;
+                    value_size = 0;
+                }
+            }
+
+            if (!Update(source, section, source.substr(key_begin, key_size), source.substr(value_begin, value_size), draft)) {
+                draft.error_line = line;
+            }
+        }
+
+        // Read-only view of a value of an embedded document.
+        class View {
+        public:
+            constexpr View(std::string_view source, const Node* nodes, const Node* node)
+                : source_(source)
+                , nodes_(nodes)
+                , node_(node)
+            {}
+
+            constexpr Type GetType() const {
+                return node_->type;
+            }
+
+            constexpr bool IsInt() const {
+                return node_->type == Type::Integer;
+            }
+
+            constexpr int32_t AsInt() const {
+                Expect(Type::Integer);
+
+                return node_->integer;
+            }
+
+            constexpr bool IsFloat() const {
+                return node_->type == Type::Float;
+            }
+
+            constexpr double AsFloat() const {
+                Expect(Type::Float);
+
+                return node_->floating;
+            }
+
+            constexpr bool IsString() const {
+                return node_->type == Type::String;
+            }
+
+            constexpr std::string_view AsString() const {
+                Expect(Type::String);
+
+                return source_.substr(node_->begin, node_->size);
+            }
+
+            constexpr bool IsBool() const {
+                return node_->type == Type::Boolean;
+            }
+
+            constexpr bool AsBool() const {
+                Expect(Type::Boolean);
+
+                return node_->boolean;
+            }
+
+            constexpr bool IsArray() const {
+                return node_->type == Type::Array;
+            }
+
+            constexpr size_t Size() const {
+                Expect(Type::Array);
+
+                return node_->size;
+            }
+
+            constexpr View operator[](size_t index) const {
+                Expect(Type::Array);
+
+                if (index >= node_->size) {
+                    throw std::runtime_error("Trying to access non-accessible value.");
+                }
+
+                return View(source_, nodes_, nodes_ + node_->begin + index);
+            }
+        private:
+            constexpr void Expect(Type type) const {
+                if (node_->type != type) {
+                    throw std::runtime_error("Trying to access non-accessible value.");
+                }
+            }
+
+            std::string_view source_;
+            const Node* nodes_;
+            const Node* node_;
+        };
+
+        template <size_t Entries, size_t Nodes>
+        class Document {
+        public:
+            constexpr Document(std::string_view source, const Draft& draft)
+                : source_(source)
+            {
+                std::copy(draft.entries.begin(), draft.entries.end(), entries_.begin());
+                std::copy(draft.nodes.begin(), draft.nodes.end(), nodes_.begin());
+            }
+
+            // Lookup of a path known while compiling. A missing one fails the build.
+            consteval View Get(std::string_view path) const {
+                std::optional<View> result = Find(path);
+
+                if (!result) {
+                    EmbeddedKeyIsMissing();
+                }
+
+                return *result;
+            }
+
+            // Lookup of any path, empty when it is missing or names a section.
+            constexpr std::optional<View> Find(std::string_view path) const {
+                for (const auto& entry: entries_) {
+                    std::string_view section = source_.substr(entry.section_begin, entry.section_size);
+                    std::string_view key = source_.substr(entry.key_begin, entry.key_size);
+
+                    bool matches = (section.empty() ? path == key : (
+                        path.size() == section.size() + key.size() + 1 &&
+                        path.starts_with(section) && path[section.size()] == '.' && path.ends_with(key)
+                    ));
+
+                    if (matches) {
+                        return View(source_, nodes_.data(), &entry.value);
+                    }
+                }
+
+                return std::nullopt;
+            }
+
+            constexpr size_t Size() const {
+                return Entries;
+            }
+        private:
+            std::string_view source_;
+            std::array<Entry, Entries> entries_;
+            std::array<Node, Nodes> nodes_;
+        };
+
+        struct Sizes {
+            size_t entries = 0;
+            size_t nodes = 0;
+        };
+
+        template <Literal Source>
+        consteval Sizes Measure() {
+            Draft draft;
+
+            Parse(Source.View(), draft);
+
+            if (draft.error_line != 0) {
+                EmbeddedDocumentIsInvalid(draft.error_line);
+            }
+
+            return {draft.entries.size(), draft.nodes.size()};
+        }
+
+        // Parsed twice: once to size the storage, once to fill it.
+        template <Literal Source>
+        consteval auto Build() {
+            constexpr Sizes sizes = Measure<Source>();
+            Draft draft;
+
+            Parse(Source.View(), draft);
+
+            return Document<sizes.entries, sizes.nodes>(Source.View(), draft);
+        }
+
+        template <Literal Source>
+        inline constexpr auto kDocument = Build<Source>();
+    }
+
+    // The document parsed while compiling, stored as a constant table:
+    //   constexpr const auto& config = omfl::Embed<R"(port = 8080)">();
+    //   static_assert(config.Get("port").AsInt() == 8080);
+    template <Literal Source>
+    consteval const auto& Embed() {
+        return embedded::kDocument<Source>;
+    }
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include "parser.h"
+
+#include <array>
+#include <cinttypes>
+#include <string_view>
+
+// Lexical rules of the format as table-driven state machines, shared by the
+// runtime parser and the compile-time one in embedded.h. Each character is
+// classified once through a 256-entry table, and every machine advances by
+// looking its next state up by that class. Only the "C" locale character
+// classes are accepted.
+namespace omfl::grammar {
+    // Characters the line scanner reacts to.
+    enum class ScanClass : uint8_t {
+        Other,
+        Newline,
+        Hash,
+        Equal,
+        Quote,
+        Open,
+        At,
+        Count
+    };
+
+    // Characters that matter for the type of a value. The letters are the ones of "true" and "false".
+    enum class ValueClass : uint8_t {
+        Other,
+        Space,
+        Digit,
+        Sign,
+        Point,
+        Quote,
+        Open,
+        Close,
+        T,
+        R,
+        U,
+        E,
+        F,
+        A,
+        L,
+        S,
+        Count
+    };
+
+    enum class KeyClass : uint8_t {
+        Other,
+        Space,
+        Name,
+        Count
+    };
+
+    struct CharClass {
+        ScanClass scan = ScanClass::Other;
+        ValueClass value = ValueClass::Other;
+        KeyClass key = KeyClass::Other;
+    };
+
+    inline constexpr std::array<CharClass, 256> kCharClasses = []() {
+        std::array<CharClass, 256> result{};
+
+        auto set_range = [&](char first, char last, ValueClass value) {
+            for (int character = first; character <= last; ++character) {
+                result[character].value = value;
+                result[character].key = KeyClass::Name;
+            }
+        };
+
+        set_range('a', 'z', ValueClass::Other);
+        set_range('A', 'Z', ValueClass::Other);
+        set_range('0', '9', ValueClass::Digit);
+
+        result['\n'].scan = ScanClass::Newline;
+        result['#'].scan = ScanClass::Hash;
+        result['='].scan = ScanClass::Equal;
+        result['\"'].scan = ScanClass::Quote;
+        result['['].scan = ScanClass::Open;
+        result['@'].scan = ScanClass::At;
+
+        result[' '].value = ValueClass::Space;
+        result['+'].value = ValueClass::Sign;
+        result['-'].value = ValueClass::Sign;
+        result['.'].value = ValueClass::Point;
+        result['\"'].value = ValueClass::Quote;
+        result['['].value = ValueClass::Open;
+        result[']'].value = ValueClass::Close;
+        result['t'].value = ValueClass::T;
+        result['r'].value = ValueClass::R;
+        result['u'].value = ValueClass::U;
+        result['e'].value = ValueClass::E;
+        result['f'].value = ValueClass::F;
+        result['a'].value = ValueClass::A;
+        result['l'].value = ValueClass::L;
+        result['s'].value = ValueClass::S;
+
+        result[' '].key = KeyClass::Space;
+        result['-'].key = KeyClass::Name;
+        result['_'].key = KeyClass::Name;
+
+        return result;
+    }();
+
+    constexpr const CharClass& Classify(char character) {
+        return kCharClasses[static_cast<uint8_t>(character)];
+    }
+
+    // Where the line scanner is within a line. A section header is read
+    // whole by ParseSections as soon as its bracket is met.
+    enum class ScanState : uint8_t {
+        Key,
+        Value,
+        String,
+        KeyComment,
+        ValueComment,
+        Count
+    };
+
+    enum class ScanAction : uint8_t {
+        Skip,
+        AppendKey,
+        AppendValue,
+        EndLine,
+        Header,
+        // An include directive when includes are allowed and nothing precedes it, part of the key otherwise.
+        Include,
+        Fail
+    };
+
+    struct ScanStep {
+        ScanState next = ScanState::Key;
+        ScanAction action = ScanAction::Skip;
+    };
+
+    inline constexpr auto kScanSteps = []() {
+        using enum ScanClass;
+
+        std::array<std::array<ScanStep, size_t(Count)>, size_t(ScanState::Count)> result{};
+
+        auto set = [&](ScanState state, ScanClass type, ScanState next, ScanAction action) {
+            result[size_t(state)][size_t(type)] = {next, action};
+        };
+
+        auto set_all = [&](ScanState state, ScanState next, ScanAction action) {
+            for (size_t type = 0; type < size_t(Count); ++type) {
+                result[size_t(state)][type] = {next, action};
+            }
+        };
+
+        set_all(ScanState::Key, ScanState::Key, ScanAction::AppendKey);
+        set(ScanState::Key, Hash, ScanState::KeyComment, ScanAction::Skip);
+        set(ScanState::Key, Equal, ScanState::Value, ScanAction::Skip);
+        set(ScanState::Key, Open, ScanState::Key, ScanAction::Header);
+        set(ScanState::Key, At, ScanState::Key, ScanAction::Include);
+
+        set_all(ScanState::Value, ScanState::Value, ScanAction::AppendValue);
+        set(ScanState::Value, Hash, ScanState::ValueComment, ScanAction::Skip);
+        set(ScanState::Value, Equal, ScanState::Value, ScanAction::Fail);
+        set(ScanState::Value, Quote, ScanState::String, ScanAction::AppendValue);
+
+        set_all(ScanState::String, ScanState::String, ScanAction::AppendValue);
+        set(ScanState::String, Quote, ScanState::Value, ScanAction::AppendValue);
+
+        // A bracket opens a header even after a comment on the key side, and
+        // the comment then carries on over the line after the header.
+        set_all(ScanState::KeyComment, ScanState::KeyComment, ScanAction::Skip);
+        set(ScanState::KeyComment, Open, ScanState::KeyComment, ScanAction::Header);
+
+        set_all(ScanState::ValueComment, ScanState::ValueComment, ScanAction::Skip);
+
+        for (size_t state = 0; state < size_t(ScanState::Count); ++state) {
+            result[state][size_t(Newline)] = {ScanState::Key, ScanAction::EndLine};
+        }
+
+        return result;
+    }();
+
+    constexpr ScanStep Scan(ScanState state, char character) {
+        return kScanSteps[size_t(state)][size_t(Classify(character).scan)];
+    }
+
+    // Checks a key as its characters arrive, spaces around it included.
+    class KeyScanner {
+    public:
+        enum class State : uint8_t {
+            Start,
+            Name,
+            End,
+            Invalid,
+            Count
+        };
+
+        constexpr void Feed(char character) {
+            state_ = kSteps[size_t(state_)][size_t(Classify(character).key)];
+        }
+
+        constexpr bool Valid() const {
+            return state_ == State::Name || state_ == State::End;
+        }
+
+        constexpr void Reset() {
+            state_ = State::Start;
+        }
+    private:
+        static constexpr std::array<std::array<State, size_t(KeyClass::Count)>, size_t(State::Count)> kSteps = {{
+            {State::Invalid, State::Start, State::Name},
+            {State::Invalid, State::End, State::Name},
+            {State::Invalid, State::End, State::Invalid},
+            {State::Invalid, State::Invalid, State::Invalid},
+        }};
+
+        State state_ = State::Start;
+    };
+
+    // Types a value as its characters arrive, spaces around it included.
+    class ValueScanner {
+    public:
+        enum class State : uint8_t {
+            Start,
+            Sign,
+            Integer,
+            IntegerEnd,
+            Point,
+            Fraction,
+            FractionEnd,
+            String,
+            StringEnd,
+            Array,
+            ArrayEnd,
+            T,
+            Tr,
+            Tru,
+            F,
+            Fa,
+            Fal,
+            Fals,
+            Boolean,
+            BooleanEnd,
+            Invalid,
+            Count
+        };
+
+        constexpr void Feed(char character) {
+            ValueClass type = Classify(character).value;
+
+            state_ = kSteps[size_t(state_)][size_t(type)];
+
+            // Brackets are only balanced in arrays, which a finite table cannot count.
+            if (state_ == State::Array) {
+                if (type == ValueClass::Open) {
+                    ++balance_;
+                } else if (type == ValueClass::Close) {
+                    if (balance_ == 0) {
+                        state_ = State::Invalid;
+                    } else if (--balance_ == 0) {
+                        state_ = State::ArrayEnd;
+                    }
+                }
+            }
+        }
+
+        // Type of the value fed so far, Undefined if it is none.
+        constexpr Type GetType() const {
+            return kTypes[size_t(state_)];
+        }
+
+        constexpr void Reset() {
+            state_ = State::Start;
+            balance_ = 0;
+        }
+    private:
+        static constexpr auto kSteps = []() {
+            using enum ValueClass;
+
+            std::array<std::array<State, size_t(Count)>, size_t(State::Count)> result{};
+
+            for (auto& row: result) {
+                row.fill(State::Invalid);
+            }
+
+            auto set = [&](State state, ValueClass type, State next) {
+                result[size_t(state)][size_t(type)] = next;
+            };
+
+            set(State::Start, Space, State::Start);
+            set(State::Start, Digit, State::Integer);
+            set(State::Start, Sign, State::Sign);
+            set(State::Start, Quote, State::String);
+            set(State::Start, Open, State::Array);
+            set(State::Start, T, State::T);
+            set(State::Start, F, State::F);
+
+            set(State::Sign, Digit, State::Integer);
+
+            set(State::Integer, Digit, State::Integer);
+            set(State::Integer, Point, State::Point);
+            set(State::Integer, Space, State::IntegerEnd);
+            set(State::IntegerEnd, Space, State::IntegerEnd);
+
+            set(State::Point, Digit, State::Fraction);
+            set(State::Fraction, Digit, State::Fraction);
+            set(State::Fraction, Space, State::FractionEnd);
+            set(State::FractionEnd, Space, State::FractionEnd);
+
+            result[size_t(State::String)].fill(State::String);
+            set(State::String, Quote, State::StringEnd);
+            set(State::StringEnd, Space, State::StringEnd);
+
+            result[size_t(State::Array)].fill(State::Array);
+            result[size_t(State::ArrayEnd)].fill(State::Array);
+            set(State::ArrayEnd, Space, State::ArrayEnd);
+            set(State::ArrayEnd, Close, State::Invalid);
+
+            set(State::T, R, State::Tr);
+            set(State::Tr, U, State::Tru);
+            set(State::Tru, E, State::Boolean);
+            set(State::F, A, State::Fa);
+            set(State::Fa, L, State::Fal);
+            set(State::Fal, S, State::Fals);
+            set(State::Fals, E, State::Boolean);
+            set(State::Boolean, Space, State::BooleanEnd);
+            set(State::BooleanEnd, Space, State::BooleanEnd);
+
+            return result;
+        }();
+
+        static constexpr auto kTypes = []() {
+            std::array<Type, size_t(State::Count)> result{};
+
+            result.fill(Type::Undefined);
+            result[size_t(State::Integer)] = Type::Integer;
+            result[size_t(State::IntegerEnd)] = Type::Integer;
+            result[size_t(State::Fraction)] = Type::Float;
+            result[size_t(State::FractionEnd)] = Type::Float;
+            result[size_t(State::StringEnd)] = Type::String;
+            result[size_t(State::ArrayEnd)] = Type::Array;
+            result[size_t(State::Boolean)] = Type::Boolean;
+            result[size_t(State::BooleanEnd)] = Type::Boolean;
+
+            return result;
+        }();
+
+        State state_ = State::Start;
+        size_t balance_ = 0;
+    };
+
+    constexpr bool CheckKeyValidity(std::string_view key) {
+        if (key.empty()) {
+            return false;
+        }
+
+        for (auto character: key) {
+            if (Classify(character).key != KeyClass::Name) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Type of a value, ignoring spaces around it.
+    constexpr Type GetValueType(std::string_view value) {
+        ValueScanner scanner;
+
+        for (auto character: value) {
+            scanner.Feed(character);
+        }
+
+        return scanner.GetType();
+    }
+}
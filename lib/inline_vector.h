@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace omfl {
+    // Vector of trivially copyable values keeping up to N of them in place
+    // and moving to the heap only once it outgrows that.
+    template <typename T, size_t N>
+    class InlineVector {
+        static_assert(std::is_trivially_copyable_v<T>);
+    public:
+        InlineVector() = default;
+
+        InlineVector(const InlineVector& other) {
+            CopyFrom(other);
+        }
+
+        InlineVector(InlineVector&& other) noexcept {
+            StealFrom(other);
+        }
+
+        InlineVector& operator=(const InlineVector& other) {
+            if (this != &other) {
+                Release();
+                CopyFrom(other);
+            }
+
+            return *this;
+        }
+
+        InlineVector& operator=(InlineVector&& other) noexcept {
+            if (this != &other) {
+                Release();
+                StealFrom(other);
+            }
+
+            return *this;
+        }
+
+        ~InlineVector() {
+            Release();
+        }
+
+        void PushBack(const T& value) {
+            if (size_ == capacity_) {
+                Reallocate(capacity_ * 2);
+            }
+
+            Data()[size_++] = value;
+        }
+
+        void Clear() {
+            size_ = 0;
+        }
+
+        T* Data() {
+            return IsInline() ? storage_.inline_values : storage_.heap_values;
+        }
+
+        const T* Data() const {
+            return IsInline() ? storage_.inline_values : storage_.heap_values;
+        }
+
+        size_t Size() const {
+            return size_;
+        }
+
+        bool Empty() const {
+            return size_ == 0;
+        }
+
+        // Values the heap buffer has room for, 0 while they are kept in place.
+        size_t HeapCapacity() const {
+            return IsInline() ? 0 : capacity_;
+        }
+
+        const T& operator[](size_t index) const {
+            return Data()[index];
+        }
+
+        const T* begin() const {
+            return Data();
+        }
+
+        const T* end() const {
+            return Data() + size_;
+        }
+    private:
+        bool IsInline() const {
+            return capacity_ == N;
+        }
+
+        void Reallocate(uint32_t capacity) {
+            T* values = new T[capacity];
+
+            std::memcpy(values, Data(), size_ * sizeof(T));
+            Release();
+
+            storage_.heap_values = values;
+            capacity_ = capacity;
+        }
+
+        void Release() {
+            if (!IsInline()) {
+                delete[] storage_.heap_values;
+                capacity_ = N;
+            }
+        }
+
+        void CopyFrom(const InlineVector& other) {
+            if (other.size_ > N) {
+                storage_.heap_values = new T[other.size_];
+                capacity_ = other.size_;
+            }
+
+            std::memcpy(Data(), other.Data(), other.size_ * sizeof(T));
+            size_ = other.size_;
+        }
+
+        void StealFrom(InlineVector& other) {
+            if (other.IsInline()) {
+                std::memcpy(storage_.inline_values, other.storage_.inline_values, other.size_ * sizeof(T));
+            } else {
+                storage_.heap_values = other.storage_.heap_values;
+                capacity_ = other.capacity_;
+                other.capacity_ = N;
+            }
+
+            size_ = other.size_;
+            other.size_ = 0;
+        }
+
+        union Storage {
+            T inline_values[N];
+            T* heap_values;
+        } storage_;
+
+        uint32_t size_ = 0;
+        uint32_t capacity_ = N;
+    };
+}
@@ -0,0 +1,182 @@
+#include "layered.h"
+
+#include <future>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+    // Calls visit(path) for item, found at path, and for everything below it,
+    // walking sections with an explicit stack. Path is restored afterwards.
+    template <typename Visit>
+    void VisitPaths(const omfl::Item& item, std::string& path, Visit visit) {
+        visit(path);
+
+        if (!item.IsSection()) {
+            return;
+        }
+
+        size_t path_size = path.size();
+        std::vector<std::tuple<const omfl::Item*, const omfl::Item*, size_t>> ranges = {{item.begin(), item.end(), path_size}};
+
+        while (!ranges.empty()) {
+            auto& [next, end, prefix_size] = ranges.back();
+
+            if (next == end) {
+                ranges.pop_back();
+                continue;
+            }
+
+            const omfl::Item& child = *next++;
+
+            path.resize(prefix_size);
+            path += '.';
+            path += child.GetKey();
+            visit(path);
+
+            if (child.IsSection()) {
+                ranges.emplace_back(child.begin(), child.end(), path.size());
+            }
+        }
+
+        path.resize(path_size);
+    }
+}
+
+omfl::LayeredConfig omfl::LayeredConfig::Load(const std::vector<std::filesystem::path>& layers, const ParseOptions& options) {
+    LayeredConfig result;
+    std::vector<std::future<Parser>> parsed;
+
+    result.layers_ = layers;
+    parsed.reserve(layers.size());
+
+    for (const auto& layer: layers) {
+        parsed.push_back(std::async(std::launch::async, [&layer, &options]() {
+            ParseOptions layer_options = options;
+            layer_options.build_value_index = false;
+
+            return parse(layer, layer_options);
+        }));
+    }
+
+    std::string path;
+
+    for (uint32_t i = 0; i < parsed.size(); ++i) {
+        Parser layer = parsed[i].get();
+
+        if (!layer.valid()) {
+            result.valid_ = false;
+
+            continue;
+        }
+
+        result.Merge(result.merged_.GetRoot(), layer.GetRoot(), path, i);
+    }
+
+    if (!result.valid_) {
+        result.merged_.MarkUnsuccessful();
+    } else if (options.build_value_index) {
+        result.merged_.BuildValueIndex();
+    }
+
+    return result;
+}
+
+bool omfl::LayeredConfig::valid() const {
+    return valid_;
+}
+
+const omfl::Parser& omfl::LayeredConfig::GetMerged() const {
+    return merged_;
+}
+
+const omfl::Item& omfl::LayeredConfig::Get(std::string_view name) const {
+    return merged_.Get(name);
+}
+
+const std::filesystem::path& omfl::LayeredConfig::GetProvenance(std::string_view name) const {
+    auto position = provenance_.find(std::string(name));
+
+    if (position == provenance_.end()) {
+        throw std::runtime_error("Addressing to an non-existing key/section.");
+    }
+
+    return layers_[position->second];
+}
+
+void omfl::LayeredConfig::Merge(Item& target, const Item& overlay, std::string& path, uint32_t layer) {
+    // Sections merged into each other, walked with an explicit stack. Each
+    // frame keeps the hash its target had before, which the parent section
+    // accounts for once the target is done.
+    struct Frame {
+        Item* target;
+        const Item* next;
+        const Item* end;
+        size_t path_size;
+        uint64_t previous;
+    };
+
+    size_t path_size = path.size();
+    std::vector<Frame> frames = {{&target, overlay.begin(), overlay.end(), path_size, target.Hash()}};
+
+    while (!frames.empty()) {
+        Frame& frame = frames.back();
+
+        if (frame.next == frame.end) {
+            Item* merged = frame.target;
+            uint64_t previous = frame.previous;
+
+            merged->UpdateHash();
+            frames.pop_back();
+
+            if (!frames.empty()) {
+                std::get<SectionTable>(frames.back().target->GetValue()).UpdateChildHash(previous, merged->Hash());
+            }
+
+            continue;
+        }
+
+        const Item& child = *frame.next++;
+        auto& items = std::get<SectionTable>(frame.target->GetValue());
+
+        path.resize(frame.path_size);
+
+        if (!path.empty()) {
+            path += '.';
+        }
+
+        path += child.GetKey();
+
+        Item* existing = items.Find(child.GetKey());
+
+        if (existing != nullptr && existing->IsSection() && child.IsSection()) {
+            provenance_[path] = layer;
+            frames.push_back({existing, child.begin(), child.end(), path.size(), existing->Hash()});
+        } else {
+            if (existing != nullptr) {
+                uint64_t previous = existing->Hash();
+
+                Forget(*existing, path);
+                *existing = child;
+                items.UpdateChildHash(previous, existing->Hash());
+            } else {
+                items.Insert(child);
+            }
+
+            Record(child, path, layer);
+        }
+    }
+
+    path.resize(path_size);
+}
+
+void omfl::LayeredConfig::Forget(const Item& item, std::string& path) {
+    VisitPaths(item, path, [this](const std::string& key) {
+        provenance_.erase(key);
+    });
+}
+
+void omfl::LayeredConfig::Record(const Item& item, std::string& path, uint32_t layer) {
+    VisitPaths(item, path, [this, layer](const std::string& key) {
+        provenance_[key] = layer;
+    });
+}
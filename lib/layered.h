@@ -0,0 +1,39 @@
+#pragma once
+
+#include "parser.h"
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace omfl {
+    // Several OMFL files merged into one read-only tree. Layers are given from
+    // the base up and later layers win:
+    //   - sections present in several layers are merged key by key;
+    //   - a value (arrays included) replaces whatever the key held before;
+    //   - a section replaces an earlier value under the same key, and vice versa.
+    class LayeredConfig {
+    public:
+        // Parses all layers concurrently, then merges them in order.
+        static LayeredConfig Load(const std::vector<std::filesystem::path>& layers, const ParseOptions& options = {});
+
+        bool valid() const;
+
+        const Parser& GetMerged() const;
+        const Item& Get(std::string_view name) const;
+
+        // The layer that last set the key or section.
+        const std::filesystem::path& GetProvenance(std::string_view name) const;
+    private:
+        void Merge(Item& target, const Item& overlay, std::string& path, uint32_t layer);
+        void Forget(const Item& item, std::string& path);
+        void Record(const Item& item, std::string& path, uint32_t layer);
+
+        Parser merged_;
+        std::vector<std::filesystem::path> layers_;
+        std::unordered_map<std::string, uint32_t> provenance_;
+        bool valid_ = true;
+    };
+}
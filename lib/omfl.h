@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+ * C interface of the OMFL parser, exported by the `omfl` shared library.
+ *
+ * Documents and items are opaque handles. Items are borrowed from their
+ * document and stay valid until omfl_free is called on it; strings are
+ * returned as pointer and length into the document and are not terminated.
+ * A NULL item, e.g. from a failed omfl_find, is an undefined item with an
+ * empty key and no children, so lookups can be chained into the getters.
+ * No function throws or aborts across this boundary.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(OMFL_BUILDING_LIBRARY)
+#    define OMFL_API __declspec(dllexport)
+#  else
+#    define OMFL_API __declspec(dllimport)
+#  endif
+#else
+#  define OMFL_API __attribute__((visibility("default")))
+#endif
+
+#define OMFL_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct omfl_document omfl_document;
+typedef struct omfl_item omfl_item;
+
+typedef struct omfl_string {
+    const char* data;
+    size_t size;
+} omfl_string;
+
+typedef enum omfl_type {
+    OMFL_UNDEFINED = 0,
+    OMFL_INT = 1,
+    OMFL_FLOAT = 2,
+    OMFL_STRING = 3,
+    OMFL_BOOL = 4,
+    OMFL_ARRAY = 5,
+    OMFL_SECTION = 6
+} omfl_type;
+
+typedef enum omfl_status {
+    OMFL_OK = 0,
+    /* The input is not valid OMFL. */
+    OMFL_INVALID = 1,
+    /* The file could not be read. */
+    OMFL_IO_ERROR = 2,
+    OMFL_NO_MEMORY = 3
+} omfl_status;
+
+/* OMFL_ABI_VERSION of the loaded library. */
+OMFL_API uint32_t omfl_abi_version(void);
+
+/* On success *document receives a handle to release with omfl_free, otherwise NULL. */
+OMFL_API omfl_status omfl_parse_buffer(const char* data, size_t size, omfl_document** document);
+OMFL_API omfl_status omfl_parse_file(const char* path, omfl_document** document);
+OMFL_API void omfl_free(omfl_document* document);
+
+OMFL_API const omfl_item* omfl_root(const omfl_document* document);
+
+/* Resolves a dotted path below a section. NULL when any part of it is missing. */
+OMFL_API const omfl_item* omfl_find(const omfl_item* section, const char* path, size_t path_size);
+
+OMFL_API omfl_type omfl_item_type(const omfl_item* item);
+OMFL_API omfl_string omfl_item_key(const omfl_item* item);
+
+/* Each getter returns 1 and stores the value when the item has that type, 0 otherwise. */
+OMFL_API int omfl_get_i32(const omfl_item* item, int32_t* value);
+OMFL_API int omfl_get_f64(const omfl_item* item, double* value);
+OMFL_API int omfl_get_bool(const omfl_item* item, int* value);
+OMFL_API int omfl_get_str(const omfl_item* item, omfl_string* value);
+
+/* Number of children of a section or elements of an array, 0 for other items. */
+OMFL_API size_t omfl_size(const omfl_item* item);
+/* Children in insertion order, or array elements. NULL past the end. */
+OMFL_API const omfl_item* omfl_at(const omfl_item* item, size_t index);
+
+/* Arrays made only of integers or only of floats, viewed in place. */
+OMFL_API int omfl_get_i32_array(const omfl_item* item, const int32_t** data, size_t* size);
+OMFL_API int omfl_get_f64_array(const omfl_item* item, const double** data, size_t* size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,111 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+    // A worker's remaining slice [begin, end) packed into one word, so the owner
+    // taking from the front and thieves taking from the back agree through a single CAS.
+    class Slice {
+    public:
+        void Reset(uint32_t begin, uint32_t end) {
+            range_.store(Pack(begin, end), std::memory_order_relaxed);
+        }
+
+        bool PopFront(uint32_t& index) {
+            uint64_t range = range_.load(std::memory_order_relaxed);
+
+            while (Begin(range) < End(range)) {
+                if (range_.compare_exchange_weak(range, Pack(Begin(range) + 1, End(range)), std::memory_order_acq_rel)) {
+                    index = Begin(range);
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        bool PopBack(uint32_t& index) {
+            uint64_t range = range_.load(std::memory_order_relaxed);
+
+            while (Begin(range) < End(range)) {
+                if (range_.compare_exchange_weak(range, Pack(Begin(range), End(range) - 1), std::memory_order_acq_rel)) {
+                    index = End(range) - 1;
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    private:
+        static uint64_t Pack(uint32_t begin, uint32_t end) {
+            return (static_cast<uint64_t>(begin) << 32) | end;
+        }
+
+        static uint32_t Begin(uint64_t range) {
+            return range >> 32;
+        }
+
+        static uint32_t End(uint64_t range) {
+            return static_cast<uint32_t>(range);
+        }
+
+        // Separate cache lines keep owners from invalidating each other's slices.
+        alignas(64) std::atomic<uint64_t> range_{0};
+    };
+}
+
+void omfl::ParallelFor(size_t count, size_t workers, const std::function<void(size_t worker, size_t index)>& task) {
+    if (count > UINT32_MAX) {
+        throw std::length_error("Too many tasks for ParallelFor.");
+    }
+
+    if (workers <= 1 || count <= 1) {
+        for (size_t index = 0; index < count; ++index) {
+            task(0, index);
+        }
+
+        return;
+    }
+
+    auto slices = std::make_unique<Slice[]>(workers);
+
+    for (size_t worker = 0; worker < workers; ++worker) {
+        slices[worker].Reset(count * worker / workers, count * (worker + 1) / workers);
+    }
+
+    auto run = [&](size_t worker) {
+        uint32_t index;
+
+        while (slices[worker].PopFront(index)) {
+            task(worker, index);
+        }
+
+        for (size_t offset = 1; offset < workers; ++offset) {
+            Slice& victim = slices[(worker + offset) % workers];
+
+            while (victim.PopBack(index)) {
+                task(worker, index);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+
+    for (size_t worker = 1; worker < workers; ++worker) {
+        threads.emplace_back(run, worker);
+    }
+
+    run(0);
+
+    for (auto& thread: threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace omfl {
+    // Calls task(worker, index) once for every index in [0, count) using `workers` threads,
+    // the calling one included. Each worker drains its own contiguous slice from the front,
+    // then steals single indices from the back of the other slices. The task must not throw.
+    void ParallelFor(size_t count, size_t workers, const std::function<void(size_t worker, size_t index)>& task);
+}
@@ -1,31 +1,130 @@
 #include "parser.h"
+#include "document.h"
+#include "grammar.h"
+#include "parallel.h"
+#include "value_index.h"
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
+#include <charconv>
 #include <fstream>
+#include <iterator>
+#include <mutex>
 #include <stack>
 #include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 std::vector<std::string_view> ParseWay(std::string_view str);
-bool CheckKeyValidity(std::string_view key);
-omfl::Type GetValueType(std::string_view value);
-std::pair<std::any, bool> ConvertValue(const std::string& value, const omfl::Type& type);
-void PrettifyString(std::string& str);
-std::pair<std::vector<std::string>, bool> ParseSections(std::string_view str, size_t& index);
-std::pair<std::any, bool> ConstructValueArray(std::string_view value);
-bool Update(omfl::Parser& parser, const std::vector<std::string>& current_sections, std::string& current_key, std::string& current_value);
-
-omfl::Item::Item(std::string_view _key, const std::any& _value, Type _value_type)
+std::pair<omfl::Value, bool> ConvertValue(const std::string& value, const omfl::Type& type);
+void TrimTrailingSpaces(std::string& str);
+bool ParseSections(std::string_view str, size_t& index, size_t max_depth, std::vector<std::string>& result);
+std::pair<omfl::Value, bool> ConstructValueArray(std::string_view value);
+const omfl::Item& UndefinedItem();
+uint64_t MixHash(uint64_t value);
+uint64_t HashValue(const omfl::Value& value);
+void MatchPattern(const omfl::Item& root, const std::vector<std::string_view>& way, std::vector<const omfl::Item*>& result);
+void CountString(const std::string& str, size_t& used, omfl::MemoryReport& report);
+bool HasEmptySection(const omfl::SectionTable& section);
+
+struct IncludeContext {
+    std::filesystem::path directory;
+    std::vector<std::filesystem::path> stack;
+    // Longest chain of nested includes below the current file, and every file it pulled in.
+    size_t depth = 0;
+    std::vector<std::filesystem::path> files;
+};
+
+// Parsed include fragments shared by the whole process, keyed by canonical path
+// and the options the fragment was parsed under. Entries are revalidated by modification time, then by content hash, of the
+// fragment's own file only; edits to files it includes in turn are not tracked.
+struct IncludeCache {
+    struct Entry {
+        std::filesystem::file_time_type modification_time;
+        size_t content_hash;
+        size_t depth;
+        std::vector<std::filesystem::path> files;
+        std::shared_ptr<const omfl::Parser> parser;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+bool ReadFile(const std::filesystem::path& path, size_t max_bytes, std::string& result);
+IncludeCache& GetIncludeCache();
+std::string IncludeCacheKey(const std::filesystem::path& path, const omfl::ParseOptions& options);
+std::shared_ptr<const omfl::Parser> LoadIncluded(const std::filesystem::path& path, const omfl::ParseOptions& options, IncludeContext& includes);
+
+// Buffers of the parse loop, kept between documents so their capacity is reused.
+struct ParseScratch {
+    std::vector<std::string> current_sections;
+    std::string current_key;
+    std::string current_value;
+
+    // Running totals of the current document, checked against ParseLimits.
+    size_t keys = 0;
+    size_t memory = 0;
+
+    // Position within the current line, carried over when parsing is resumed mid-line.
+    omfl::grammar::ScanState state = omfl::grammar::ScanState::Key;
+    omfl::grammar::KeyScanner key_scanner;
+    omfl::grammar::ValueScanner value_scanner;
+
+    // ParseOptions::sections split into keys.
+    std::vector<std::vector<std::string>> kept_sections;
+
+    // Receives the spans of every value line when set, see omfl::ParseWithSpans.
+    std::vector<omfl::EntrySpans>* spans = nullptr;
+};
+
+bool KeepSection(const std::vector<std::string>& section_way, const ParseScratch& scratch);
+size_t SkipSection(std::string_view str, size_t index, bool allow_includes, omfl::grammar::ScanState& state);
+void RecordSpans(std::string_view str, size_t line_end, ParseScratch& scratch);
+
+bool Charge(ParseScratch& scratch, const omfl::ParseLimits& limits, size_t keys, size_t memory);
+bool CheckArrayLimits(std::string_view value, const omfl::ParseLimits& limits, size_t depth, size_t& elements);
+bool Update(omfl::Parser& parser, const omfl::ParseLimits& limits, ParseScratch& scratch);
+bool AddSection(omfl::Parser& parser, const omfl::ParseLimits& limits, ParseScratch& scratch, std::vector<std::string>& section_way, const omfl::Item& section);
+bool Include(omfl::Parser& parser, std::string_view directive, const omfl::ParseOptions& options, IncludeContext& includes, ParseScratch& scratch);
+
+struct omfl::ParserContext::Scratch : ParseScratch {
+    // The document of a parse started by Begin and not yet completed by Resume.
+    std::string_view str;
+    Parser* parser = nullptr;
+    ParseOptions options;
+    IncludeContext includes;
+    size_t index = 0;
+};
+
+bool BeginDocument(omfl::Parser& parser, std::string_view str, const omfl::ParseOptions& options, ParseScratch& scratch);
+size_t ParseRange(omfl::Parser& parser, std::string_view str, size_t index, size_t stop, const omfl::ParseOptions& options, IncludeContext& includes, ParseScratch& scratch);
+void FinishDocument(omfl::Parser& parser, const omfl::ParseOptions& options, ParseScratch& scratch);
+void ParseDocument(omfl::Parser& parser, std::string_view str, const omfl::ParseOptions& options, IncludeContext& includes, ParseScratch& scratch);
+
+omfl::Item::Item(std::string_view _key, Value _value, Type _value_type)
     : key(_key)
-    , value(_value)
+    , value(std::move(_value))
     , value_type(_value_type)
-{}
+{
+    UpdateHash();
+}
+
+bool omfl::Item::operator==(const Item& other) const {
+    return value_type == other.value_type && key == other.key && value == other.value;
+}
 
 const std::string& omfl::Item::GetKey() const {
     return key;
 }
 
-std::any& omfl::Item::GetValue() {
+omfl::Value& omfl::Item::GetValue() {
+    return value;
+}
+
+const omfl::Value& omfl::Item::GetValue() const {
     return value;
 }
 
@@ -33,6 +132,40 @@ const omfl::Type omfl::Item::GetType() const {
     return value_type;
 }
 
+uint64_t omfl::Item::Hash() const {
+    return hash;
+}
+
+void omfl::Item::UpdateHash() {
+    hash = MixHash(std::hash<std::string_view>()(key) ^ HashValue(value));
+}
+
+std::span<const omfl::Item> omfl::Item::CountMemory(MemoryReport& report) const {
+    CountString(key, report.keys, report);
+
+    if (const auto* string = std::get_if<std::string>(&value)) {
+        CountString(*string, report.strings, report);
+    } else if (const auto* array = std::get_if<ValueArray>(&value)) {
+        return array->CountMemory(report);
+    } else if (const auto* section = std::get_if<SectionTable>(&value)) {
+        return section->CountMemory(report);
+    }
+
+    return {};
+}
+
+// Strings short enough to live inside the object hold no heap memory.
+void CountString(const std::string& str, size_t& used, omfl::MemoryReport& report) {
+    const char* object = reinterpret_cast<const char*>(&str);
+
+    if (str.data() >= object && str.data() < object + sizeof(str)) {
+        return;
+    }
+
+    used += str.size() + 1;
+    report.overhead += str.capacity() - str.size();
+}
+
 std::vector<std::string_view> ParseWay(std::string_view str) {
     std::vector<std::string_view> result;
     int last_string_index = 0;
@@ -55,31 +188,76 @@ std::vector<std::string_view> ParseWay(std::string_view str) {
 }
 
 const omfl::Item& omfl::Item::Get(std::string_view name) const {
-    if (name.find('.') != std::string::npos) {
-        return Get(ParseWay(name), 0);
-    }
-
-    if (value_type != Type::Section) {
+    if (value_type != Type::Section && name.find('.') == std::string::npos) {
         return *this;
     }
 
-    const auto& items = std::any_cast<const std::map<std::string, Item, std::less<>>&>(value);
+    const Item* item = Find(name);
 
-    if (items.find(name) == items.end()) {
+    if (item == nullptr) {
         throw std::runtime_error("Addressing to an non-existing key/section.");
     }
 
-    return items.find(name)->second;
+    return *item;
 }
 
 const omfl::Item& omfl::Item::Get(const std::vector<std::string_view>& way, size_t index) const {
-    if (index == way.size()) {
-        return *this;
+    const Item* current = this;
+
+    for (; index < way.size(); ++index) {
+        current = (current->IsSection() ? std::get<SectionTable>(current->value).Find(way[index]) : nullptr);
+
+        if (current == nullptr) {
+            throw std::runtime_error("Addressing to an non-existing key/section.");
+        }
+    }
+
+    return *current;
+}
+
+const omfl::Item* omfl::Item::Find(std::string_view path) const noexcept {
+    const Item* current = this;
+
+    while (true) {
+        size_t end = std::min(path.find('.'), path.size());
+        const auto* table = std::get_if<SectionTable>(&current->value);
+
+        current = (table == nullptr ? nullptr : table->Find(path.substr(0, end)));
+
+        if (current == nullptr || end == path.size()) {
+            return current;
+        }
+
+        path.remove_prefix(end + 1);
     }
+}
+
+int32_t omfl::Item::GetIntOr(std::string_view path, int32_t value) const noexcept {
+    const Item* item = Find(path);
+    const auto* result = (item == nullptr ? nullptr : std::get_if<int32_t>(&item->value));
+
+    return (result == nullptr ? value : *result);
+}
+
+double omfl::Item::GetFloatOr(std::string_view path, double value) const noexcept {
+    const Item* item = Find(path);
+    const auto* result = (item == nullptr ? nullptr : std::get_if<double>(&item->value));
 
-    const auto& items = std::any_cast<const std::map<std::string, Item, std::less<>>&>(value);
+    return (result == nullptr ? value : *result);
+}
+
+std::string_view omfl::Item::GetStringOr(std::string_view path, std::string_view value) const noexcept {
+    const Item* item = Find(path);
+    const auto* result = (item == nullptr ? nullptr : std::get_if<std::string>(&item->value));
+
+    return (result == nullptr ? value : std::string_view(*result));
+}
 
-    return items.find(way[index])->second.Get(way, index + 1);
+bool omfl::Item::GetBoolOr(std::string_view path, bool value) const noexcept {
+    const Item* item = Find(path);
+    const auto* result = (item == nullptr ? nullptr : std::get_if<bool>(&item->value));
+
+    return (result == nullptr ? value : *result);
 }
 
 bool omfl::Item::IsInt() const {
@@ -87,7 +265,7 @@ bool omfl::Item::IsInt() const {
 }
 
 int32_t omfl::Item::AsInt() const {
-    return std::any_cast<int32_t>(value);
+    return std::get<int32_t>(value);
 }
 
 int32_t omfl::Item::AsIntOrDefault(int32_t value) const {
@@ -103,7 +281,7 @@ bool omfl::Item::IsFloat() const {
 }
 
 double omfl::Item::AsFloat() const {
-    return std::any_cast<double>(value);
+    return std::get<double>(value);
 }
 
 double omfl::Item::AsFloatOrDefault(double value) const {
@@ -119,7 +297,7 @@ bool omfl::Item::IsString() const {
 }
 
 std::string_view omfl::Item::AsString() const {
-    return std::any_cast<const std::string&>(value);
+    return std::get<std::string>(value);
 }
 
 std::string_view omfl::Item::AsStringOrDefault(std::string_view value) const {
@@ -135,7 +313,7 @@ bool omfl::Item::IsBool() const {
 }
 
 bool omfl::Item::AsBool() const {
-    return std::any_cast<bool>(value);
+    return std::get<bool>(value);
 }
 
 bool omfl::Item::AsBoolOrDefault(bool value) const {
@@ -150,524 +328,2003 @@ bool omfl::Item::IsArray() const {
     return value_type == Type::Array;
 }
 
+bool omfl::Item::IsSection() const {
+    return value_type == Type::Section;
+}
+
 const omfl::Item& omfl::Item::operator[](size_t index) const {
     if (!IsArray()) {
         throw std::runtime_error("Trying to access non-accessible value.");
     }
 
-    const ValueArray& array = std::any_cast<const ValueArray&>(value);
+    const ValueArray& array = std::get<ValueArray>(value);
 
     return array.Get(index);
 }
 
-omfl::ValueArray::ValueArray()
-    : trash_item_(Item("", "", Type::Undefined))
-{}
-
-void omfl::ValueArray::Add(const std::any& value, Type type) {
-    values_.push_back(Item("", value, type));
-}
-
-const omfl::Item& omfl::ValueArray::Get(size_t index) const {
-    if (index < values_.size()) {
-        return values_[index];
+size_t omfl::Item::Size() const {
+    if (IsSection()) {
+        return std::get<SectionTable>(value).Size();
     }
 
-    return trash_item_;
-}
+    if (!IsArray()) {
+        throw std::runtime_error("Trying to access non-accessible value.");
+    }
 
-bool omfl::Parser::valid() const {
-    return successful_parse_;
+    return std::get<ValueArray>(value).Size();
 }
 
-void omfl::Parser::MarkUnsuccessful() {
-    successful_parse_ = false;
-}
+const omfl::Item* omfl::Item::begin() const {
+    if (IsSection()) {
+        return std::get<SectionTable>(value).begin();
+    }
 
-bool omfl::Parser::Add(const std::vector<std::string>& section_way, const Item& appending_item) {
-    return tree_.AddItem(section_way, appending_item);
-}
+    if (!IsArray()) {
+        throw std::runtime_error("Trying to access non-accessible value.");
+    }
 
-const omfl::Item& omfl::Parser::Get(std::string_view name) const {
-    return tree_.GetItem(name);
+    return std::get<ValueArray>(value).begin();
 }
 
-omfl::Parser::Trie::Trie()
-    : root_(Item("", std::map<std::string, Item, std::less<>>(), Type::Section))
-{}
-
-bool omfl::Parser::Trie::AddItem(const std::vector<std::string>& section_way, const Item& appending_item) {
-    Item* current_node = &root_;
-    
-    for (const auto& section: section_way) {
-        auto& items = std::any_cast<std::map<std::string, Item, std::less<>>&>(current_node->GetValue());
-
-        if (items.find(section) == items.end()) {
-            items.insert({section, Item(section, std::map<std::string, Item, std::less<>>(), Type::Section)});
-        }
-
-        current_node = &items.at(section);
+const omfl::Item* omfl::Item::end() const {
+    if (IsSection()) {
+        return std::get<SectionTable>(value).end();
     }
 
-    auto& items = std::any_cast<std::map<std::string, Item, std::less<>>&>(current_node->GetValue());
-
-    if (items.find(appending_item.GetKey()) != items.end()) {
-        return false;
+    if (!IsArray()) {
+        throw std::runtime_error("Trying to access non-accessible value.");
     }
 
-    items.insert({appending_item.GetKey(), appending_item});
-
-    return true;
-}
-
-const omfl::Item& omfl::Parser::Trie::GetItem(std::string_view name) const {
-    return root_.Get(name);
+    return std::get<ValueArray>(value).end();
 }
 
-bool CheckKeyValidity(std::string_view key) {
-    if (key.empty()) {
-        return false;
+std::span<const int32_t> omfl::Item::AsIntSpan() const {
+    if (!IsArray()) {
+        throw std::runtime_error("Trying to access non-accessible value.");
     }
 
-    for (auto character: key) {
-        if (
-            !std::isalnum(character) &&
-            !(character == '-' || character == '_')
-        ) {
-            return false;
-        }
+    return std::get<ValueArray>(value).AsIntSpan();
+}
+
+std::span<const double> omfl::Item::AsFloatSpan() const {
+    if (!IsArray()) {
+        throw std::runtime_error("Trying to access non-accessible value.");
     }
 
-    return true;
+    return std::get<ValueArray>(value).AsFloatSpan();
 }
 
-omfl::Type GetValueType(std::string_view value) {
-    using omfl::Type;
-    
-    if (value.empty()) {
-        return Type::Undefined;
+omfl::StringViews omfl::Item::AsStringViews() const {
+    if (!IsArray()) {
+        throw std::runtime_error("Trying to access non-accessible value.");
     }
 
-    if (value[0] == '\"' && value.back() == '\"') {
-        // Presumably, it is a string.
+    return std::get<ValueArray>(value).AsStringViews();
+}
 
-        if (std::count(value.begin(), value.end(), '\"') == 2) {
-            return Type::String;
-        } else {
-            return Type::Undefined;
-        }
-    } else if (value[0] == '[' && value.back() == ']') {
-        int32_t balance = 0;
+uint64_t MixHash(uint64_t value) {
+    // Finalizer of splitmix64.
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111eb;
+    value ^= value >> 31;
 
-        for (auto character: value) {
-            if (character == '[') {
-                ++balance;
-            } else if (character == ']') {
-                if (balance == 0) {
-                    return Type::Undefined;
-                }
+    return value;
+}
 
-                --balance;
-            }
-        }
+uint64_t HashValue(const omfl::Value& value) {
+    uint64_t content = 0;
 
-        if (balance > 0) {
-            return Type::Undefined;
+    switch (value.index()) {
+        case omfl::Type::Integer:
+            content = static_cast<uint32_t>(std::get<int32_t>(value));
+            break;
+        case omfl::Type::Float: {
+            // 0.0 and -0.0 compare equal, so they hash equally too.
+            double number = std::get<double>(value);
+            content = std::bit_cast<uint64_t>(number == 0 ? 0.0 : number);
+            break;
         }
+        case omfl::Type::String:
+            content = std::hash<std::string_view>()(std::get<std::string>(value));
+            break;
+        case omfl::Type::Boolean:
+            content = std::get<bool>(value);
+            break;
+        case omfl::Type::Array:
+            content = std::get<omfl::ValueArray>(value).Hash();
+            break;
+        case omfl::Type::Section:
+            content = std::get<omfl::SectionTable>(value).Hash();
+            break;
+    }
 
-        return Type::Array;
-    } else if (value == "true" || value == "false") {
-        return Type::Boolean;
-    } else {
-        if (value[0] == '.') {
-            return Type::Undefined;
-        }
+    return MixHash(content + value.index() * 0x9e3779b97f4a7c15);
+}
 
-        if ((value[0] == '+' || value[0] == '-') && value.size() == 1) {
-            return Type::Undefined;
-        }
+const omfl::Item& UndefinedItem() {
+    static const omfl::Item undefined_item("", omfl::Value(), omfl::Type::Undefined);
 
-        if (
-            !std::isdigit(value[0]) &&
-            !(value[0] == '+' || value[0] == '-')
-        ) {
-            return Type::Undefined;
-        }
+    return undefined_item;
+}
 
-        size_t pluses = 0;
-        size_t minuses = 0;
-        size_t points = 0;
-        size_t point_index = value.size() + 1;
+omfl::ValueArray::ValueArray() = default;
 
-        for (size_t i = 0; i < value.size(); ++i) {
-            char character = value[i];
+omfl::ValueArray::ValueArray(const ValueArray& other)
+    : storage_(other.storage_)
+    , hash_(other.hash_)
+{}
 
-            if (character == '+') {
-                ++pluses;
-            } else if (character == '-') {
-                ++minuses;
-            } else if (character == '.') {
-                ++points;
-                point_index = i;
-            } else if (!std::isdigit(character)){
-                return Type::Undefined;
-            }
-        }
+omfl::ValueArray::ValueArray(ValueArray&& other) noexcept
+    : storage_(std::move(other.storage_))
+    , unpacked_items_(other.unpacked_items_.exchange(nullptr))
+    , hash_(other.hash_)
+{}
 
-        if (pluses + minuses > 1 || points > 1) {
-            return Type::Undefined;
+omfl::ValueArray& omfl::ValueArray::operator=(const ValueArray& other) {
+    if (this != &other) {
+        if (auto* items = std::get_if<std::vector<Item>>(&storage_)) {
+            SectionTable::Release(*items);
         }
 
-        if ((pluses == 1 || minuses == 1) && value[0] != '+' && value[0] != '-') {
-            return Type::Undefined;
-        }
+        storage_ = other.storage_;
+        delete unpacked_items_.exchange(nullptr);
+        hash_ = other.hash_;
+    }
 
-        if (points > 0) {
-            assert(point_index != value.size() + 1);
-            
-            if (
-                (point_index == 1 && !std::isdigit(value[0])) ||
-                point_index == value.size() - 1
-            ) {
-                return Type::Undefined;
-            }
+    return *this;
+}
 
-            return Type::Float;
+omfl::ValueArray& omfl::ValueArray::operator=(ValueArray&& other) noexcept {
+    if (this != &other) {
+        if (auto* items = std::get_if<std::vector<Item>>(&storage_)) {
+            SectionTable::Release(*items);
         }
 
-        return Type::Integer;
+        storage_ = std::move(other.storage_);
+        delete unpacked_items_.exchange(other.unpacked_items_.exchange(nullptr));
+        hash_ = other.hash_;
     }
 
-    return Type::Undefined;
+    return *this;
 }
 
-std::pair<std::any, bool> ConstructValueArray(std::string_view value) {
-    using omfl::Type;
+omfl::ValueArray::~ValueArray() {
+    delete unpacked_items_.load();
 
-    omfl::ValueArray result;
-    std::string buff;
-    bool ok = true;
-    int32_t balance = 0;
+    if (auto* items = std::get_if<std::vector<Item>>(&storage_)) {
+        SectionTable::Release(*items);
+    }
+}
 
-    for (size_t i = 1; i < value.size(); ++i) {
-        if ((value[i] == ',' && balance == 0) || i == value.size() - 1) {
-            if (buff.empty()) {
-                continue;
-            }
+bool omfl::ValueArray::operator==(const ValueArray& other) const {
+    if (Size() != other.Size()) {
+        return false;
+    }
 
-            PrettifyString(buff);
+    if (storage_.index() == other.storage_.index()) {
+        if (const auto* ints = std::get_if<InlineVector<int32_t, 4>>(&storage_)) {
+            return std::equal(ints->begin(), ints->end(), other.AsIntSpan().begin());
+        } else if (const auto* floats = std::get_if<InlineVector<double, 2>>(&storage_)) {
+            return std::equal(floats->begin(), floats->end(), other.AsFloatSpan().begin());
+        } else if (const auto* strings = std::get_if<PackedStrings>(&storage_)) {
+            const auto& other_strings = std::get<PackedStrings>(other.storage_);
 
-            Type type = GetValueType(buff);
+            return strings->chars == other_strings.chars && std::equal(strings->ends.begin(), strings->ends.end(), other_strings.ends.begin());
+        }
+    }
 
-            if (type == Type::Undefined) {
-                ok = false;
+    return std::equal(begin(), end(), other.begin());
+}
 
-                break;
-            }
+void omfl::ValueArray::Add(Value value, Type type) {
+    // Mixing after each element makes the hash depend on their order.
+    hash_ = MixHash(hash_ + HashValue(value));
+
+    if (Size() == 0) {
+        if (type == Type::Integer) {
+            storage_.emplace<InlineVector<int32_t, 4>>();
+        } else if (type == Type::Float) {
+            storage_.emplace<InlineVector<double, 2>>();
+        } else if (type == Type::String) {
+            storage_.emplace<PackedStrings>();
+        }
+    }
 
-            auto [value, successful] = ConvertValue(buff, type);
+    if (type == Type::Integer && std::holds_alternative<InlineVector<int32_t, 4>>(storage_)) {
+        std::get<InlineVector<int32_t, 4>>(storage_).PushBack(std::get<int32_t>(value));
 
-            if (!successful) {
-                ok = false;
+        return;
+    }
 
-                break;
-            }
+    if (type == Type::Float && std::holds_alternative<InlineVector<double, 2>>(storage_)) {
+        std::get<InlineVector<double, 2>>(storage_).PushBack(std::get<double>(value));
 
-            result.Add(value, type);
-            buff.clear();
-        } else {
-            buff.push_back(value[i]);
+        return;
+    }
 
-            if (value[i] == '[') {
-                ++balance;
-            } else if (value[i] == ']') {
-                if (balance == 0) {
-                    ok = false;
+    if (type == Type::String && std::holds_alternative<PackedStrings>(storage_)) {
+        auto& strings = std::get<PackedStrings>(storage_);
 
-                    break;
-                }
+        strings.chars += std::get<std::string>(value);
+        strings.ends.PushBack(strings.chars.size());
 
-                --balance;
-            }
-        }
+        return;
     }
 
-    return {result, ok};
+    Unpack();
+    std::get<std::vector<Item>>(storage_).emplace_back("", std::move(value), type);
 }
 
-std::pair<std::any, bool> ConvertValue(const std::string& value, const omfl::Type& type) {
-    using omfl::Type;
+const omfl::Item& omfl::ValueArray::Get(size_t index) const {
+    if (index < Size()) {
+        return Items()[index];
+    }
 
-    if (type == Type::Integer) {
-        return {std::stoi(value), true};
-    } else if (type == Type::Float) {
-        return {std::stod(value), true};
-    } else if (type == Type::String) {
-        return {value.substr(1, value.size() - 2), true};
-    } else if (type == Type::Boolean) {
-        if (value == "true") {
-            return {true, true};
-        }
+    return UndefinedItem();
+}
 
-        return {false, true};
+size_t omfl::ValueArray::Size() const {
+    if (const auto* items = std::get_if<std::vector<Item>>(&storage_)) {
+        return items->size();
+    } else if (const auto* ints = std::get_if<InlineVector<int32_t, 4>>(&storage_)) {
+        return ints->Size();
+    } else if (const auto* floats = std::get_if<InlineVector<double, 2>>(&storage_)) {
+        return floats->Size();
     }
 
-    assert(type == Type::Array);
+    return std::get<PackedStrings>(storage_).ends.Size();
+}
 
-    return ConstructValueArray(value);
+const omfl::Item* omfl::ValueArray::begin() const {
+    return Items().data();
 }
 
-void PrettifyString(std::string& str) {
-    while (!str.empty() && str.back() == ' ') {
-        str.pop_back();
-    }
+const omfl::Item* omfl::ValueArray::end() const {
+    return Items().data() + Size();
+}
 
-    size_t prefix_spaces = 0;
+std::span<const int32_t> omfl::ValueArray::AsIntSpan() const {
+    if (const auto* ints = std::get_if<InlineVector<int32_t, 4>>(&storage_)) {
+        return {ints->Data(), ints->Size()};
+    }
 
-    for (; prefix_spaces < str.size(); ++prefix_spaces) {
-        if (str[prefix_spaces] != ' ') {
-            break;
-        }
+    if (Size() == 0) {
+        return {};
     }
 
-    str = str.substr(prefix_spaces);
+    throw std::runtime_error("Array is not made of integers only.");
 }
 
-bool Update(omfl::Parser& parser, const std::vector<std::string>& current_sections, std::string& current_key, std::string& current_value) {
-    PrettifyString(current_key);
-    PrettifyString(current_value);
-    
-    if (current_key.empty() && current_value.empty()) {
-        return true;
+std::span<const double> omfl::ValueArray::AsFloatSpan() const {
+    if (const auto* floats = std::get_if<InlineVector<double, 2>>(&storage_)) {
+        return {floats->Data(), floats->Size()};
     }
 
-    if (!CheckKeyValidity(current_key)) {
-        return false;
+    if (Size() == 0) {
+        return {};
     }
 
-    omfl::Type value_type = GetValueType(current_value);
+    throw std::runtime_error("Array is not made of floats only.");
+}
 
-    if (value_type == omfl::Type::Undefined) {
-        return false;
+omfl::StringViews omfl::ValueArray::AsStringViews() const {
+    if (const auto* strings = std::get_if<PackedStrings>(&storage_)) {
+        return StringViews(strings->chars, {strings->ends.Data(), strings->ends.Size()});
     }
 
-    auto [converted_value, successful] = ConvertValue(current_value, value_type);
-
-    if (!successful) {
-        return false;
+    if (Size() == 0) {
+        return {};
     }
 
-    bool ok = parser.Add(current_sections, omfl::Item(current_key, converted_value, value_type));
+    throw std::runtime_error("Array is not made of strings only.");
+}
 
-    if (!ok) {
-        return false;
+omfl::Type omfl::ValueArray::PackedType() const {
+    if (std::holds_alternative<InlineVector<int32_t, 4>>(storage_)) {
+        return Type::Integer;
+    } else if (std::holds_alternative<InlineVector<double, 2>>(storage_)) {
+        return Type::Float;
+    } else if (std::holds_alternative<PackedStrings>(storage_)) {
+        return Type::String;
     }
 
-    current_key.clear();
-    current_value.clear();
+    return Type::Undefined;
+}
 
-    return true;
+uint64_t omfl::ValueArray::Hash() const {
+    return hash_;
 }
 
-std::pair<std::vector<std::string>, bool> ParseSections(std::string_view str, size_t& index) {
-    std::vector<std::string> result;
-    std::string buff;
-    bool ok = true;
+std::span<const omfl::Item> omfl::ValueArray::CountMemory(MemoryReport& report) const {
+    auto count_packed = [&report](const auto& values, size_t& used) {
+        size_t capacity = values.HeapCapacity();
 
-    for (; index < str.size() && str[index] != '\n'; ++index) {
-        if (str[index] == '.' || str[index] == ']') {
-            ok &= CheckKeyValidity(buff);
-            result.emplace_back(buff);
-            buff.clear();
-        } else {
-            buff += str[index];
+        if (capacity > 0) {
+            used += values.Size() * sizeof(*values.Data());
+            report.overhead += (capacity - values.Size()) * sizeof(*values.Data());
         }
-    }
-
-    assert(buff.empty());
+    };
 
-    return {result, ok};
-}
-
-std::pair<std::vector<std::string>, bool> ParseSections(std::ifstream& stream) {
-    std::string buff;
-    char character;
+    if (const auto* unpacked = unpacked_items_.load(std::memory_order_acquire)) {
+        report.arrays += sizeof(*unpacked) + unpacked->size() * sizeof(Item);
+        report.overhead += (unpacked->capacity() - unpacked->size()) * sizeof(Item);
 
-    for (; stream.get(character) && character != '\n';) {
-        buff.push_back(character);
+        for (const Item& item: *unpacked) {
+            item.CountMemory(report);
+        }
     }
-    
-    size_t starting_index = 0;
 
-    return ParseSections(buff, starting_index);
-}
+    if (const auto* items = std::get_if<std::vector<Item>>(&storage_)) {
+        report.arrays += items->size() * sizeof(Item);
+        report.overhead += (items->capacity() - items->size()) * sizeof(Item);
 
-omfl::Parser omfl::parse(const std::filesystem::path& path) {
-    Parser parser;
-    std::ifstream stream(path);
+        return *items;
+    } else if (const auto* ints = std::get_if<InlineVector<int32_t, 4>>(&storage_)) {
+        count_packed(*ints, report.arrays);
+    } else if (const auto* floats = std::get_if<InlineVector<double, 2>>(&storage_)) {
+        count_packed(*floats, report.arrays);
+    } else {
+        const auto& strings = std::get<PackedStrings>(storage_);
 
-    if (!stream.is_open()) {
-        throw std::runtime_error("No such file as " + path.filename().string());
+        CountString(strings.chars, report.strings, report);
+        count_packed(strings.ends, report.arrays);
     }
 
-    std::vector<std::string> current_sections;
-    std::string current_key;
-    std::string current_value;
-    bool equal_sign_seen = false;
-    bool in_string = false;
-    bool ignore = false;
-    char character;
-
-    for (size_t index = 0; stream.get(character); ++index) {
-        if (character == '[' && !equal_sign_seen) {
-            auto [current_sections_, successful] = ParseSections(stream);
-            current_sections = current_sections_;
+    return {};
+}
 
-            if (!successful) {
-                parser.MarkUnsuccessful();
+void omfl::ValueArray::Unpack() {
+    if (std::holds_alternative<std::vector<Item>>(storage_)) {
+        return;
+    }
 
-                break;
-            }
+    std::vector<Item> items = Items();
 
-            current_key.clear();
-            current_value.clear();
+    storage_ = std::move(items);
+    delete unpacked_items_.exchange(nullptr);
+}
 
-            continue;
-        }
-        
-        if (character == '\n') {
-            equal_sign_seen = false;
-            in_string = false;
-            ignore = false;
+const std::vector<omfl::Item>& omfl::ValueArray::Items() const {
+    if (const auto* items = std::get_if<std::vector<Item>>(&storage_)) {
+        return *items;
+    }
 
-            if (!Update(parser, current_sections, current_key, current_value)) {
-                parser.MarkUnsuccessful();
+    if (const auto* unpacked = unpacked_items_.load(std::memory_order_acquire)) {
+        return *unpacked;
+    }
 
-                break;
-            }
+    // Packed arrays build their Items on first indexed access. Concurrent
+    // readers may race to build them; only the first published copy is kept.
+    auto* items = new std::vector<Item>();
+    items->reserve(Size());
 
-            continue;
+    if (const auto* ints = std::get_if<InlineVector<int32_t, 4>>(&storage_)) {
+        for (int32_t value: *ints) {
+            items->emplace_back("", Value(std::in_place_type<int32_t>, value), Type::Integer);
         }
-
-        if (character == '#' && !in_string) {
-            ignore = true;
+    } else if (const auto* floats = std::get_if<InlineVector<double, 2>>(&storage_)) {
+        for (double value: *floats) {
+            items->emplace_back("", Value(std::in_place_type<double>, value), Type::Float);
         }
+    } else {
+        const auto& strings = std::get<PackedStrings>(storage_);
+        size_t begin = 0;
 
-        if (ignore) {
-            continue;
+        for (uint32_t end: strings.ends) {
+            items->emplace_back("", Value(std::in_place_type<std::string>, strings.chars.substr(begin, end - begin)), Type::String);
+            begin = end;
         }
+    }
 
-        if (character == '=' && !in_string) {
-            if (equal_sign_seen) {
-                parser.MarkUnsuccessful();
-                
-                break;
-            }
+    std::vector<Item>* expected = nullptr;
 
-            equal_sign_seen = true;
+    if (!unpacked_items_.compare_exchange_strong(expected, items, std::memory_order_acq_rel)) {
+        delete items;
 
-            continue;
-        }
+        return *expected;
+    }
 
-        if (!equal_sign_seen) {
-            current_key.push_back(character);
-        } else {
-            if (character == '\"') {
-                in_string ^= 1;
-            }
+    return *items;
+}
 
-            current_value.push_back(character);
-        }
-    }
+omfl::SectionTable& omfl::SectionTable::operator=(const SectionTable& other) {
+    if (this != &other) {
+        // Held before releasing, in case other lives below this table.
+        std::shared_ptr<Body> body = other.body_;
 
-    if ((!current_key.empty() || !current_value.empty()) && parser.valid()) {
-        if (!Update(parser, current_sections, current_key, current_value)) {
-            parser.MarkUnsuccessful();
-        }
+        ReleaseBody();
+        body_ = std::move(body);
+        hash_sum_ = other.hash_sum_;
     }
 
-    return parser;
+    return *this;
 }
 
-omfl::Parser omfl::parse(const std::string& str) {
-    Parser parser;
+omfl::SectionTable& omfl::SectionTable::operator=(SectionTable&& other) noexcept {
+    if (this != &other) {
+        std::shared_ptr<Body> body = std::move(other.body_);
+
+        ReleaseBody();
+        body_ = std::move(body);
+        hash_sum_ = other.hash_sum_;
+    }
+
+    return *this;
+}
+
+omfl::SectionTable::~SectionTable() {
+    ReleaseBody();
+}
+
+bool omfl::SectionTable::operator==(const SectionTable& other) const {
+    if (body_ == other.body_) {
+        return true;
+    }
+
+    if (Size() != other.Size()) {
+        return false;
+    }
+
+    for (const Item& item: *this) {
+        const Item* other_item = other.Find(item.GetKey());
+
+        if (other_item == nullptr || !(*other_item == item)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+omfl::Item* omfl::SectionTable::Find(std::string_view key) {
+    const Item* item = std::as_const(*this).Find(key);
+
+    if (item == nullptr) {
+        return nullptr;
+    }
+
+    size_t position = item - begin();
+
+    return &Detach().items[position];
+}
+
+const omfl::Item* omfl::SectionTable::Find(std::string_view key) const noexcept {
+    if (body_ == nullptr) {
+        return nullptr;
+    }
+
+    if (body_->index.empty()) {
+        for (const auto& item: body_->items) {
+            if (item.GetKey() == key) {
+                return &item;
+            }
+        }
+
+        return nullptr;
+    }
+
+    uint32_t position = body_->index[FindSlot(key)];
+
+    return (position == kEmptySlot ? nullptr : &body_->items[position]);
+}
+
+std::pair<omfl::Item*, bool> omfl::SectionTable::Insert(Item item) {
+    if (Item* existing = Find(item.GetKey())) {
+        return {existing, false};
+    }
+
+    Body& body = Detach();
+
+    hash_sum_ += item.Hash();
+    body.items.push_back(std::move(item));
+
+    if (body.items.size() > kLinearScanLimit) {
+        if (body.items.size() * 2 > body.index.size()) {
+            Rehash(std::max<size_t>(32, body.index.size() * 2));
+        } else {
+            body.index[FindSlot(body.items.back().GetKey())] = body.items.size() - 1;
+        }
+    }
+
+    return {&body.items.back(), true};
+}
+
+void omfl::SectionTable::Clear() {
+    if (OwnsBody()) {
+        Release(body_->items);
+        body_->items.clear();
+        body_->index.clear();
+    } else {
+        body_.reset();
+    }
+
+    hash_sum_ = 0;
+}
+
+size_t omfl::SectionTable::Size() const {
+    return (body_ == nullptr ? 0 : body_->items.size());
+}
+
+const omfl::Item* omfl::SectionTable::begin() const {
+    return (body_ == nullptr ? nullptr : body_->items.data());
+}
+
+const omfl::Item* omfl::SectionTable::end() const {
+    return (body_ == nullptr ? nullptr : body_->items.data() + body_->items.size());
+}
+
+uint64_t omfl::SectionTable::Hash() const {
+    return MixHash(hash_sum_);
+}
+
+void omfl::SectionTable::UpdateChildHash(uint64_t previous, uint64_t current) {
+    hash_sum_ += current - previous;
+}
+
+std::span<const omfl::Item> omfl::SectionTable::CountMemory(MemoryReport& report) const {
+    if (body_ == nullptr) {
+        return {};
+    }
+
+    report.sections += sizeof(Body) + body_->items.size() * sizeof(Item) + body_->index.size() * sizeof(uint32_t);
+    report.overhead += (body_->items.capacity() - body_->items.size()) * sizeof(Item);
+    report.overhead += (body_->index.capacity() - body_->index.size()) * sizeof(uint32_t);
+
+    return body_->items;
+}
+
+std::span<omfl::Item> omfl::SectionTable::OwnChildren() {
+    if (!OwnsBody()) {
+        return {};
+    }
+
+    return body_->items;
+}
+
+bool omfl::SectionTable::ShareIfEqual(const SectionTable& other) {
+    if (body_ == other.body_) {
+        return true;
+    }
+
+    if (Hash() != other.Hash() || Size() != other.Size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < Size(); ++i) {
+        const Item& item = body_->items[i];
+        const Item& other_item = other.body_->items[i];
+
+        if (item.GetType() == Type::Section && other_item.GetType() == Type::Section) {
+            if (item.GetKey() != other_item.GetKey() || std::get<SectionTable>(item.GetValue()).body_ != std::get<SectionTable>(other_item.GetValue()).body_) {
+                return false;
+            }
+        } else if (!(item == other_item)) {
+            return false;
+        }
+    }
+
+    *this = other;
+
+    return true;
+}
+
+size_t omfl::SectionTable::FindSlot(std::string_view key) const noexcept {
+    const auto& index = body_->index;
+    size_t mask = index.size() - 1;
+    size_t slot = std::hash<std::string_view>()(key) & mask;
+
+    while (index[slot] != kEmptySlot && body_->items[index[slot]].GetKey() != key) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+bool omfl::SectionTable::OwnsBody() const {
+    if (body_ == nullptr || body_.use_count() != 1) {
+        return false;
+    }
+
+    // use_count is a relaxed load. The fence pairs it with the release done
+    // by the thread that dropped the last other copy, so its reads of the
+    // children happen before they are changed or destroyed here.
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return true;
+}
+
+omfl::SectionTable::Body& omfl::SectionTable::Detach() {
+    if (body_ == nullptr) {
+        body_ = std::make_shared<Body>();
+    } else if (!OwnsBody()) {
+        // Nested sections of the copied items stay shared.
+        body_ = std::make_shared<Body>(*body_);
+    }
+
+    return *body_;
+}
+
+void omfl::SectionTable::Release(std::vector<Item>& items) {
+    auto children = [](Item& item) -> std::vector<Item>* {
+        std::vector<Item>* result = nullptr;
+
+        if (auto* section = std::get_if<SectionTable>(&item.GetValue())) {
+            if (section->OwnsBody()) {
+                result = &section->body_->items;
+            }
+        } else if (auto* array = std::get_if<ValueArray>(&item.GetValue())) {
+            result = std::get_if<std::vector<Item>>(&array->storage_);
+        }
+
+        return (result == nullptr || result->empty() ? nullptr : result);
+    };
+
+    // Flat tables, the common case, are left to the ordinary destructors.
+    if (std::none_of(items.begin(), items.end(), [&](Item& item) { return children(item) != nullptr; })) {
+        return;
+    }
+
+    // Every nested vector is moved out before its owner is destroyed, so each
+    // destructor below only ever sees empty children.
+    std::vector<std::vector<Item>> pending;
+    pending.push_back(std::move(items));
+    items.clear();
+
+    while (!pending.empty()) {
+        std::vector<Item> current = std::move(pending.back());
+        pending.pop_back();
+
+        for (Item& item: current) {
+            if (auto* nested = children(item)) {
+                pending.push_back(std::move(*nested));
+                nested->clear();
+            }
+        }
+    }
+}
+
+void omfl::SectionTable::ReleaseBody() {
+    if (OwnsBody()) {
+        Release(body_->items);
+    }
+}
+
+void omfl::SectionTable::Rehash(size_t capacity) {
+    body_->index.assign(capacity, kEmptySlot);
+
+    for (size_t position = 0; position < body_->items.size(); ++position) {
+        body_->index[FindSlot(body_->items[position].GetKey())] = position;
+    }
+}
+
+bool omfl::Parser::operator==(const Parser& other) const {
+    return valid() == other.valid() && tree_.GetRoot() == other.tree_.GetRoot();
+}
+
+void omfl::Parser::Clear() {
+    tree_.Clear();
+    value_index_.reset();
+    successful_parse_ = true;
+}
+
+bool omfl::Parser::valid() const {
+    return successful_parse_;
+}
+
+void omfl::Parser::MarkUnsuccessful() {
+    successful_parse_ = false;
+}
+
+bool omfl::Parser::Add(const std::vector<std::string>& section_way, Item appending_item) {
+    return tree_.AddItem(section_way, std::move(appending_item));
+}
+
+void omfl::Parser::Set(std::string_view name, Value value) {
+    std::vector<std::string_view> way = ParseWay(name);
+
+    if (!std::all_of(way.begin(), way.end(), grammar::CheckKeyValidity)) {
+        throw std::runtime_error("Invalid key.");
+    }
+
+    if (std::holds_alternative<std::monostate>(value)) {
+        throw std::runtime_error("Value is undefined.");
+    }
+
+    // Parsing never produces an empty section, so a written document could not hold one.
+    if (const auto* section = std::get_if<SectionTable>(&value); section != nullptr && HasEmptySection(*section)) {
+        throw std::runtime_error("Empty sections cannot be set.");
+    }
+
+    Type type = static_cast<Type>(value.index());
+
+    tree_.SetItem(way, Item(way.back(), std::move(value), type));
+    value_index_.reset();
+}
+
+const omfl::Item& omfl::Parser::Get(std::string_view name) const {
+    return tree_.GetItem(name);
+}
+
+omfl::Item& omfl::Parser::GetRoot() {
+    return tree_.GetRoot();
+}
+
+const omfl::Item& omfl::Parser::GetRoot() const {
+    return tree_.GetRoot();
+}
+
+const omfl::Item* omfl::Parser::Find(std::string_view path) const noexcept {
+    return tree_.GetRoot().Find(path);
+}
+
+int32_t omfl::Parser::GetIntOr(std::string_view path, int32_t value) const noexcept {
+    return tree_.GetRoot().GetIntOr(path, value);
+}
+
+double omfl::Parser::GetFloatOr(std::string_view path, double value) const noexcept {
+    return tree_.GetRoot().GetFloatOr(path, value);
+}
+
+std::string_view omfl::Parser::GetStringOr(std::string_view path, std::string_view value) const noexcept {
+    return tree_.GetRoot().GetStringOr(path, value);
+}
+
+bool omfl::Parser::GetBoolOr(std::string_view path, bool value) const noexcept {
+    return tree_.GetRoot().GetBoolOr(path, value);
+}
+
+std::vector<const omfl::Item*> omfl::Parser::Query(std::string_view pattern) const {
+    std::vector<std::string_view> way = ParseWay(pattern);
+    std::vector<const Item*> result;
+
+    way.erase(std::unique(way.begin(), way.end(), [](std::string_view lhs, std::string_view rhs) {
+        return lhs == "**" && rhs == "**";
+    }), way.end());
+
+    MatchPattern(tree_.GetRoot(), way, result);
+
+    if (std::count(way.begin(), way.end(), "**") > 1) {
+        // Several recursive segments can reach the same item along different splits.
+        std::unordered_set<const Item*> seen;
+
+        result.erase(std::remove_if(result.begin(), result.end(), [&seen](const Item* item) {
+            return !seen.insert(item).second;
+        }), result.end());
+    }
+
+    return result;
+}
+
+void MatchPattern(const omfl::Item& root, const std::vector<std::string_view>& way, std::vector<const omfl::Item*>& result) {
+    // Steps run from an explicit stack in depth-first order. A step either
+    // reports an item or matches way[index] against the children of a section.
+    struct Step {
+        const omfl::Item* item;
+        size_t index;
+        bool report;
+    };
+
+    std::vector<Step> stack = {{&root, 0, false}};
+    std::vector<Step> next;
+
+    while (!stack.empty()) {
+        Step step = stack.back();
+        stack.pop_back();
+
+        if (step.report) {
+            result.push_back(step.item);
+
+            continue;
+        }
+
+        std::string_view segment = way[step.index];
+        bool last = (step.index + 1 == way.size());
+
+        auto descend = [&](const omfl::Item& child, size_t next_index) {
+            if (next_index == way.size()) {
+                next.push_back({&child, 0, true});
+            } else if (child.IsSection()) {
+                next.push_back({&child, next_index, false});
+            }
+        };
+
+        next.clear();
+
+        if (segment == "**") {
+            if (!last) {
+                next.push_back({step.item, step.index + 1, false});
+            }
+
+            for (const auto& child: *step.item) {
+                if (last) {
+                    next.push_back({&child, 0, true});
+                }
+
+                if (child.IsSection()) {
+                    next.push_back({&child, step.index, false});
+                }
+            }
+        } else if (segment == "*") {
+            for (const auto& child: *step.item) {
+                descend(child, step.index + 1);
+            }
+        } else if (const auto* child = std::get<omfl::SectionTable>(step.item->GetValue()).Find(segment)) {
+            descend(*child, step.index + 1);
+        }
+
+        stack.insert(stack.end(), next.rbegin(), next.rend());
+    }
+}
+
+void omfl::Parser::BuildValueIndex() {
+    value_index_ = std::make_shared<const ValueIndex>(tree_.GetRoot());
+}
+
+bool omfl::Parser::HasValueIndex() const {
+    return value_index_ != nullptr;
+}
+
+size_t omfl::Parser::ValueIndexMemoryUsage() const {
+    return HasValueIndex() ? value_index_->MemoryUsage() : 0;
+}
+
+size_t omfl::MemoryReport::Total() const {
+    return keys + strings + arrays + sections + value_index + overhead;
+}
+
+omfl::MemoryReport omfl::Parser::MemoryUsage() const {
+    MemoryReport report;
+    std::vector<std::span<const Item>> pending = {tree_.GetRoot().CountMemory(report)};
+    // Shared sections are told apart by where their children are stored.
+    std::unordered_set<const Item*> counted;
+
+    while (!pending.empty()) {
+        std::span<const Item> items = pending.back();
+        pending.pop_back();
+
+        for (const Item& item: items) {
+            if (item.IsSection() && item.Size() > 0 && !counted.insert(item.begin()).second) {
+                continue;
+            }
+
+            std::span<const Item> children = item.CountMemory(report);
+
+            if (!children.empty()) {
+                pending.push_back(children);
+            }
+        }
+    }
+
+    report.value_index = ValueIndexMemoryUsage();
+
+    return report;
+}
+
+void omfl::Parser::Deduplicate() {
+    // Parents are listed before their children, so walking the list backwards
+    // shares nested sections before the sections holding them are compared.
+    std::vector<SectionTable*> sections = {&std::get<SectionTable>(tree_.GetRoot().GetValue())};
+
+    for (size_t i = 0; i < sections.size(); ++i) {
+        for (Item& item: sections[i]->OwnChildren()) {
+            if (auto* section = std::get_if<SectionTable>(&item.GetValue())) {
+                sections.push_back(section);
+            }
+        }
+    }
+
+    // Copies of the first section seen with each content, which also keep
+    // its children alive once the section itself was replaced.
+    std::unordered_map<uint64_t, std::vector<SectionTable>> canonical;
+
+    for (size_t i = sections.size() - 1; i > 0; --i) {
+        SectionTable& section = *sections[i];
+
+        if (section.Size() == 0) {
+            continue;
+        }
+
+        auto& candidates = canonical[section.Hash()];
+        bool shared = false;
+
+        for (const auto& candidate: candidates) {
+            if (section.ShareIfEqual(candidate)) {
+                shared = true;
+
+                break;
+            }
+        }
+
+        if (!shared) {
+            candidates.push_back(section);
+        }
+    }
+}
+
+const std::vector<std::string>& omfl::Parser::KeysWithValue(int32_t value) const {
+    if (!HasValueIndex()) {
+        throw std::runtime_error("Value index was not built.");
+    }
+
+    return value_index_->Find(value);
+}
+
+const std::vector<std::string>& omfl::Parser::KeysWithValue(double value) const {
+    if (!HasValueIndex()) {
+        throw std::runtime_error("Value index was not built.");
+    }
+
+    return value_index_->Find(value);
+}
+
+const std::vector<std::string>& omfl::Parser::KeysWithValue(bool value) const {
+    if (!HasValueIndex()) {
+        throw std::runtime_error("Value index was not built.");
+    }
+
+    return value_index_->Find(value);
+}
+
+const std::vector<std::string>& omfl::Parser::KeysWithValue(std::string_view value) const {
+    if (!HasValueIndex()) {
+        throw std::runtime_error("Value index was not built.");
+    }
+
+    return value_index_->Find(value);
+}
+
+const std::vector<std::string>& omfl::Parser::KeysWithValue(const char* value) const {
+    return KeysWithValue(std::string_view(value));
+}
+
+omfl::Parser::Trie::Trie()
+    : root_(Item("", Value(std::in_place_type<SectionTable>), Type::Section))
+{}
+
+bool omfl::Parser::Trie::AddItem(const std::vector<std::string>& section_way, Item appending_item) {
+    // Sections from the root down, whose hashes are refreshed bottom-up afterwards.
+    InlineVector<Item*, 8> way;
+    Item* current_node = &root_;
+    bool added = true;
+
+    way.PushBack(current_node);
+    
+    for (const auto& section: section_way) {
+        auto& items = std::get<SectionTable>(current_node->GetValue());
+        Item* next_node = items.Find(section);
+
+        if (next_node == nullptr) {
+            next_node = items.Insert(Item(section, Value(std::in_place_type<SectionTable>), Type::Section)).first;
+        }
+
+        // A key and a subsection cannot share a name.
+        if (!next_node->IsSection()) {
+            added = false;
+
+            break;
+        }
+
+        current_node = next_node;
+        way.PushBack(current_node);
+    }
+
+    if (added) {
+        added = std::get<SectionTable>(current_node->GetValue()).Insert(std::move(appending_item)).second;
+    }
+
+    UpdateHashes({way.Data(), way.Size()});
+
+    return added;
+}
+
+void omfl::Parser::Trie::SetItem(const std::vector<std::string_view>& way, Item item) {
+    // Checked up front, so that a failed Set leaves the tree as it was.
+    const Item* existing = &root_;
+
+    for (size_t i = 0; i + 1 < way.size() && existing != nullptr; ++i) {
+        existing = std::get<SectionTable>(existing->GetValue()).Find(way[i]);
+
+        if (existing != nullptr && !existing->IsSection()) {
+            throw std::runtime_error("Key is not a section.");
+        }
+    }
+
+    InlineVector<Item*, 8> sections;
+    Item* current_node = &root_;
+
+    sections.PushBack(current_node);
+
+    for (size_t i = 0; i + 1 < way.size(); ++i) {
+        // Existing sections come back unshared, copied if another document held them.
+        current_node = std::get<SectionTable>(current_node->GetValue()).Insert(Item(way[i], Value(std::in_place_type<SectionTable>), Type::Section)).first;
+        sections.PushBack(current_node);
+    }
+
+    auto& items = std::get<SectionTable>(current_node->GetValue());
+
+    if (Item* target = items.Find(item.GetKey())) {
+        uint64_t previous = target->Hash();
+
+        *target = std::move(item);
+        items.UpdateChildHash(previous, target->Hash());
+    } else {
+        items.Insert(std::move(item));
+    }
+
+    UpdateHashes({sections.Data(), sections.Size()});
+}
+
+void omfl::Parser::Trie::UpdateHashes(std::span<Item* const> way) {
+    for (size_t i = way.size() - 1; i > 0; --i) {
+        uint64_t previous = way[i]->Hash();
+
+        way[i]->UpdateHash();
+        std::get<SectionTable>(way[i - 1]->GetValue()).UpdateChildHash(previous, way[i]->Hash());
+    }
+
+    root_.UpdateHash();
+}
+
+const omfl::Item& omfl::Parser::Trie::GetItem(std::string_view name) const {
+    return root_.Get(name);
+}
+
+void omfl::Parser::Trie::Clear() {
+    std::get<SectionTable>(root_.GetValue()).Clear();
+    root_.UpdateHash();
+}
+
+omfl::Item& omfl::Parser::Trie::GetRoot() {
+    return root_;
+}
+
+const omfl::Item& omfl::Parser::Trie::GetRoot() const {
+    return root_;
+}
+
+std::pair<omfl::Value, bool> ConstructValueArray(std::string_view value) {
+    using omfl::Type;
+
+    // Arrays still being filled, innermost last. Nesting is tracked here
+    // rather than on the call stack, so deep arrays cannot overflow it.
+    std::vector<omfl::ValueArray> arrays;
+    std::string buff;
+    omfl::grammar::ValueScanner scanner;
+    // Leading spaces are left out of buff, this records that there were some.
+    bool blank = false;
+    bool nested_closed = false;
+    bool in_string = false;
+    const std::pair<omfl::Value, bool> failure = {omfl::Value(), false};
+
+    for (size_t i = 0; i < value.size(); ++i) {
+        char character = value[i];
+
+        if (in_string) {
+            buff.push_back(character);
+            scanner.Feed(character);
+            in_string = (character != '\"');
+
+            continue;
+        }
+
+        if (character == '[') {
+            if (nested_closed || !buff.empty()) {
+                return failure;
+            }
+
+            arrays.emplace_back();
+            blank = false;
+        } else if (character == ',' || character == ']') {
+            // Elements with no text at all are skipped, blank ones are rejected.
+            if (!nested_closed && (blank || !buff.empty())) {
+                TrimTrailingSpaces(buff);
+
+                Type type = scanner.GetType();
+
+                if (type == Type::Undefined || type == Type::Array) {
+                    return failure;
+                }
+
+                auto [element, successful] = ConvertValue(buff, type);
+
+                if (!successful) {
+                    return failure;
+                }
+
+                arrays.back().Add(std::move(element), type);
+            }
+
+            buff.clear();
+            scanner.Reset();
+            blank = false;
+            nested_closed = false;
+
+            if (character == ']') {
+                omfl::ValueArray array = std::move(arrays.back());
+                arrays.pop_back();
+
+                if (arrays.empty()) {
+                    if (i + 1 != value.size()) {
+                        return failure;
+                    }
+
+                    return {omfl::Value(std::in_place_type<omfl::ValueArray>, std::move(array)), true};
+                }
+
+                arrays.back().Add(omfl::Value(std::in_place_type<omfl::ValueArray>, std::move(array)), Type::Array);
+                nested_closed = true;
+            }
+        } else if (nested_closed) {
+            if (character != ' ') {
+                return failure;
+            }
+        } else if (character == ' ' && buff.empty()) {
+            blank = true;
+        } else {
+            in_string = (character == '\"');
+            buff.push_back(character);
+            scanner.Feed(character);
+        }
+    }
+
+    return failure;
+}
+
+std::pair<omfl::Value, bool> ConvertValue(const std::string& value, const omfl::Type& type) {
+    using omfl::Type;
+    using omfl::Value;
+
+    if (type == Type::Integer || type == Type::Float) {
+        // from_chars reports out-of-range values instead of throwing, and rejects a leading '+'.
+        std::string_view digits = value;
+
+        if (digits[0] == '+') {
+            digits.remove_prefix(1);
+        }
+
+        const char* end = digits.data() + digits.size();
+
+        if (type == Type::Integer) {
+            int32_t result;
+            auto [position, error] = std::from_chars(digits.data(), end, result);
+
+            return {Value(std::in_place_type<int32_t>, result), error == std::errc() && position == end};
+        }
+
+        double result;
+        auto [position, error] = std::from_chars(digits.data(), end, result, std::chars_format::fixed);
+
+        return {Value(std::in_place_type<double>, result), error == std::errc() && position == end};
+    } else if (type == Type::String) {
+        return {Value(std::in_place_type<std::string>, value.substr(1, value.size() - 2)), true};
+    } else if (type == Type::Boolean) {
+        return {Value(std::in_place_type<bool>, value == "true"), true};
+    }
+
+    assert(type == Type::Array);
+
+    return ConstructValueArray(value);
+}
+
+void TrimTrailingSpaces(std::string& str) {
+    while (!str.empty() && str.back() == ' ') {
+        str.pop_back();
+    }
+}
+
+bool Charge(ParseScratch& scratch, const omfl::ParseLimits& limits, size_t keys, size_t memory) {
+    scratch.keys += keys;
+    scratch.memory += memory;
+
+    return scratch.keys <= limits.max_keys && scratch.memory <= limits.max_memory;
+}
+
+// Walks the brackets of an array literal before it is built, so that arrays
+// nested too deep or grown too long are rejected without being constructed.
+bool CheckArrayLimits(std::string_view value, const omfl::ParseLimits& limits, size_t depth, size_t& elements) {
+    struct OpenArray {
+        size_t commas = 0;
+        bool empty = true;
+    };
+
+    std::vector<OpenArray> open_arrays;
+    bool in_string = false;
+
+    for (char character: value) {
+        if (in_string) {
+            in_string = (character != '\"');
+
+            continue;
+        }
+
+        if (character != '[' && open_arrays.empty()) {
+            // Text between top-level brackets is left for the array parser to reject.
+            continue;
+        }
+
+        if (character == '[') {
+            if (depth + open_arrays.size() >= limits.max_depth) {
+                return false;
+            }
+
+            if (!open_arrays.empty()) {
+                open_arrays.back().empty = false;
+            }
+
+            open_arrays.emplace_back();
+        } else if (character == ']') {
+            size_t length = open_arrays.back().empty ? 0 : open_arrays.back().commas + 1;
+
+            if (length > limits.max_array_length) {
+                return false;
+            }
+
+            elements += length;
+            open_arrays.pop_back();
+        } else if (character == ',') {
+            ++open_arrays.back().commas;
+        } else if (character != ' ') {
+            in_string = (character == '\"');
+            open_arrays.back().empty = false;
+        }
+    }
+
+    return true;
+}
+
+bool Update(omfl::Parser& parser, const omfl::ParseLimits& limits, ParseScratch& scratch) {
+    const std::vector<std::string>& current_sections = scratch.current_sections;
+    std::string& current_key = scratch.current_key;
+    std::string& current_value = scratch.current_value;
+
+    // Leading spaces were never appended, and the key and the value were typed as they arrived.
+    TrimTrailingSpaces(current_key);
+    TrimTrailingSpaces(current_value);
+    
+    if (current_key.empty() && current_value.empty()) {
+        return true;
+    }
+
+    if (!scratch.key_scanner.Valid()) {
+        return false;
+    }
+
+    omfl::Type value_type = scratch.value_scanner.GetType();
+
+    if (value_type == omfl::Type::Undefined) {
+        return false;
+    }
+
+    size_t elements = 0;
+    bool bounded = limits.max_depth != omfl::ParseLimits::kUnlimited ||
+        limits.max_array_length != omfl::ParseLimits::kUnlimited ||
+        limits.max_memory != omfl::ParseLimits::kUnlimited;
+
+    if (value_type == omfl::Type::Array && bounded && !CheckArrayLimits(current_value, limits, current_sections.size(), elements)) {
+        return false;
+    }
+
+    if (!Charge(scratch, limits, 1, sizeof(omfl::Item) * (elements + 1) + current_key.size() + current_value.size())) {
+        return false;
+    }
+
+    auto [converted_value, successful] = ConvertValue(current_value, value_type);
+
+    if (!successful) {
+        return false;
+    }
+
+    bool ok = parser.Add(current_sections, omfl::Item(current_key, std::move(converted_value), value_type));
+
+    if (!ok) {
+        return false;
+    }
+
+    current_key.clear();
+    current_value.clear();
+    scratch.key_scanner.Reset();
+    scratch.value_scanner.Reset();
+
+    return true;
+}
+
+bool ParseSections(std::string_view str, size_t& index, size_t max_depth, std::vector<std::string>& result) {
+    size_t count = 0;
+    size_t name_begin = index;
+    bool closed = false;
+    bool ok = true;
+
+    // Names are assigned over the previous header's strings to reuse their capacity.
+    for (; index < str.size() && str[index] != '\n' && !closed; ++index) {
+        if (str[index] == '.' || str[index] == ']') {
+            std::string_view name = str.substr(name_begin, index - name_begin);
+
+            ok &= omfl::grammar::CheckKeyValidity(name);
+
+            if (count < result.size()) {
+                result[count].assign(name);
+            } else {
+                result.emplace_back(name);
+            }
+
+            if (++count > max_depth) {
+                ok = false;
+
+                break;
+            }
+
+            name_begin = index + 1;
+            closed = (str[index] == ']');
+        }
+    }
+
+    result.resize(count);
+
+    // Only spaces and a comment may follow the closing bracket.
+    size_t line_end = std::min(str.find('\n', index), str.size());
+    std::string_view rest = str.substr(index, line_end - index);
+    size_t rest_begin = rest.find_first_not_of(' ');
+
+    index = line_end;
+
+    return ok && closed && (rest_begin == std::string_view::npos || rest[rest_begin] == '#');
+}
+
+bool ReadFile(const std::filesystem::path& path, size_t max_bytes, std::string& result) {
+    std::ifstream stream(path, std::ios::binary);
+
+    if (!stream.is_open()) {
+        throw std::runtime_error("No such file as " + path.filename().string());
+    }
+
+    std::error_code error;
+    size_t size = std::filesystem::file_size(path, error);
+
+    if (!error && size > max_bytes) {
+        return false;
+    }
+
+    result.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+    return result.size() <= max_bytes;
+}
+
+bool AddSection(omfl::Parser& parser, const omfl::ParseLimits& limits, ParseScratch& scratch, std::vector<std::string>& section_way, const omfl::Item& section) {
+    // Children left to splice, one range per section below the included one.
+    std::vector<std::pair<const omfl::Item*, const omfl::Item*>> ranges = {{section.begin(), section.end()}};
+    size_t depth = section_way.size();
+    bool ok = true;
+
+    while (ok && !ranges.empty()) {
+        auto& [next, end] = ranges.back();
+
+        if (next == end) {
+            ranges.pop_back();
+
+            if (!ranges.empty()) {
+                section_way.pop_back();
+            }
+
+            continue;
+        }
+
+        const omfl::Item& child = *next++;
+
+        if (child.IsSection()) {
+            if (section_way.size() >= limits.max_depth) {
+                ok = false;
+            } else {
+                section_way.push_back(child.GetKey());
+                ranges.emplace_back(child.begin(), child.end());
+            }
+        } else {
+            // Spliced values are charged as one item each, their arrays as already built.
+            ok = Charge(scratch, limits, 1, sizeof(omfl::Item) * (child.IsArray() ? child.Size() + 1 : 1) + child.GetKey().size()) &&
+                 parser.Add(section_way, child);
+        }
+    }
+
+    section_way.resize(depth);
+
+    return ok;
+}
+
+IncludeCache& GetIncludeCache() {
+    static IncludeCache cache;
+
+    return cache;
+}
 
-    std::vector<std::string> current_sections;
-    std::string current_key;
-    std::string current_value;
-    bool equal_sign_seen = false;
-    bool in_string = false;
-    bool ignore = false;
+// Fragments are only reused under the options that were checked while
+// parsing them, so a stricter caller never gets a tree its limits let through.
+std::string IncludeCacheKey(const std::filesystem::path& path, const omfl::ParseOptions& options) {
+    const omfl::ParseLimits& limits = options.limits;
+    std::string result = path.string();
 
-    for (size_t index = 0; index < str.size(); ++index) {
-        char character = str[index];
+    for (size_t value: {limits.max_bytes, limits.max_depth, limits.max_array_length, limits.max_keys, limits.max_memory, options.max_include_depth}) {
+        result += '\0';
+        result += std::to_string(value);
+    }
+
+    result += '\0';
+    result += (options.allow_includes ? 'i' : '-');
+    result += (options.deduplicate ? 'd' : '-');
+
+    return result;
+}
 
-        if (character == '[' && !equal_sign_seen) {
-            auto [current_sections_, successful] = ParseSections(str, ++index);
-            current_sections = current_sections_;
+std::shared_ptr<const omfl::Parser> LoadIncluded(const std::filesystem::path& path, const omfl::ParseOptions& options, IncludeContext& includes) {
+    std::error_code error;
+    std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path, error);
 
-            if (!successful) {
-                parser.MarkUnsuccessful();
+    if (error || includes.stack.size() >= options.max_include_depth) {
+        return nullptr;
+    }
 
-                break;
+    // Cached fragments carry their own nested includes, which count towards
+    // the depth limit and cycle detection too.
+    auto fits = [&](const IncludeCache::Entry& entry) {
+        if (includes.stack.size() + entry.depth > options.max_include_depth) {
+            return false;
+        }
+
+        for (const auto& file: entry.files) {
+            if (std::find(includes.stack.begin(), includes.stack.end(), file) != includes.stack.end()) {
+                return false;
             }
+        }
 
-            current_key.clear();
-            current_value.clear();
+        includes.depth = std::max(includes.depth, entry.depth);
+        includes.files.insert(includes.files.end(), entry.files.begin(), entry.files.end());
 
-            continue;
+        return true;
+    };
+
+    if (std::find(includes.stack.begin(), includes.stack.end(), canonical_path) != includes.stack.end()) {
+        return nullptr;
+    }
+
+    auto modification_time = std::filesystem::last_write_time(canonical_path, error);
+
+    if (error) {
+        return nullptr;
+    }
+
+    IncludeCache& cache = GetIncludeCache();
+    std::string cache_key = IncludeCacheKey(canonical_path, options);
+
+    {
+        std::lock_guard lock(cache.mutex);
+        auto position = cache.entries.find(cache_key);
+
+        if (position != cache.entries.end() && position->second.modification_time == modification_time) {
+            return fits(position->second) ? position->second.parser : nullptr;
+        }
+    }
+
+    std::string content;
+
+    if (!ReadFile(canonical_path, options.limits.max_bytes, content)) {
+        return nullptr;
+    }
+
+    size_t content_hash = std::hash<std::string_view>()(content);
+
+    {
+        // Touched but unchanged files keep their parsed tree.
+        std::lock_guard lock(cache.mutex);
+        auto position = cache.entries.find(cache_key);
+
+        if (position != cache.entries.end() && position->second.content_hash == content_hash) {
+            position->second.modification_time = modification_time;
+
+            return fits(position->second) ? position->second.parser : nullptr;
         }
-        
-        if (character == '\n') {
-            equal_sign_seen = false;
-            in_string = false;
-            ignore = false;
+    }
+
+    auto fragment = std::make_shared<omfl::Parser>();
+    IncludeContext fragment_includes{canonical_path.parent_path(), includes.stack, 0, {}};
+
+    fragment_includes.stack.push_back(canonical_path);
+    ParseScratch fragment_scratch;
+
+    // Included files land in a section that was kept, so they are kept whole.
+    omfl::ParseOptions fragment_options = options;
+
+    fragment_options.sections.clear();
+    ParseDocument(*fragment, content, fragment_options, fragment_includes, fragment_scratch);
+
+    if (!fragment->valid()) {
+        return nullptr;
+    }
+
+    IncludeCache::Entry entry{modification_time, content_hash, fragment_includes.depth + 1, std::move(fragment_includes.files), fragment};
+
+    entry.files.push_back(canonical_path);
+    includes.depth = std::max(includes.depth, entry.depth);
+    includes.files.insert(includes.files.end(), entry.files.begin(), entry.files.end());
+
+    std::lock_guard lock(cache.mutex);
+    cache.entries[cache_key] = std::move(entry);
+
+    return fragment;
+}
+
+bool Include(omfl::Parser& parser, std::string_view directive, const omfl::ParseOptions& options, IncludeContext& includes, ParseScratch& scratch) {
+    constexpr std::string_view kInclude = "include";
+
+    size_t begin = directive.find_first_not_of(' ');
+
+    if (begin == std::string_view::npos || directive.substr(begin, kInclude.size()) != kInclude) {
+        return false;
+    }
+
+    directive.remove_prefix(begin + kInclude.size());
+    begin = directive.find_first_not_of(' ');
+
+    if (begin == 0 || begin == std::string_view::npos || directive[begin] != '\"') {
+        return false;
+    }
+
+    size_t end = directive.find('\"', begin + 1);
+
+    if (end == std::string_view::npos) {
+        return false;
+    }
+
+    size_t rest = directive.find_first_not_of(' ', end + 1);
+
+    if (rest != std::string_view::npos && directive[rest] != '#') {
+        return false;
+    }
 
-            if (!Update(parser, current_sections, current_key, current_value)) {
-                parser.MarkUnsuccessful();
+    std::filesystem::path path = directive.substr(begin + 1, end - begin - 1);
+
+    if (path.is_relative()) {
+        path = includes.directory / path;
+    }
+
+    auto fragment = LoadIncluded(path, options, includes);
+
+    if (fragment == nullptr) {
+        return false;
+    }
+
+    std::vector<std::string> section_way = scratch.current_sections;
+
+    return AddSection(parser, options.limits, scratch, section_way, fragment->GetRoot());
+}
+
+bool BeginDocument(omfl::Parser& parser, std::string_view str, const omfl::ParseOptions& options, ParseScratch& scratch) {
+    scratch.current_sections.clear();
+    scratch.current_key.clear();
+    scratch.current_value.clear();
+    scratch.keys = 0;
+    scratch.memory = 0;
+    scratch.state = omfl::grammar::ScanState::Key;
+    scratch.key_scanner.Reset();
+    scratch.value_scanner.Reset();
+    scratch.kept_sections.clear();
+
+    for (const auto& section: options.sections) {
+        std::vector<std::string_view> way = ParseWay(section);
+
+        scratch.kept_sections.emplace_back(way.begin(), way.end());
+    }
+
+    if (str.size() > options.limits.max_bytes) {
+        parser.MarkUnsuccessful();
+
+        return false;
+    }
+
+    return true;
+}
+
+// Runs the parse loop from index until it reaches stop. Section headers and
+// includes are consumed whole, so the returned position may lie past stop;
+// it is str.size() once the document is done or the parse has failed.
+size_t ParseRange(omfl::Parser& parser, std::string_view str, size_t index, size_t stop, const omfl::ParseOptions& options, IncludeContext& includes, ParseScratch& scratch) {
+    using omfl::grammar::ScanAction;
+
+    std::vector<std::string>& current_sections = scratch.current_sections;
+    std::string& current_key = scratch.current_key;
+    std::string& current_value = scratch.current_value;
+
+    omfl::grammar::ScanState state = scratch.state;
+    bool failed = false;
+
+    stop = std::min(stop, str.size());
+
+    // Keys ahead of the first header belong to the root, which a section filter leaves out.
+    if (index == 0 && !KeepSection(current_sections, scratch)) {
+        index = SkipSection(str, 0, options.allow_includes, state);
+    }
+
+    for (; index < stop && !failed; ++index) {
+        char character = str[index];
+        omfl::grammar::ScanStep step = omfl::grammar::Scan(state, character);
+
+        state = step.next;
+
+        switch (step.action) {
+            case ScanAction::Skip:
+                break;
+            case ScanAction::Include:
+                if (options.allow_includes && current_key.empty()) {
+                    size_t line_end = std::min(str.find('\n', index), str.size());
+
+                    failed = !Include(parser, str.substr(index + 1, line_end - index - 1), options, includes, scratch);
+                    index = line_end - 1;
+
+                    break;
+                }
+
+                [[fallthrough]];
+            case ScanAction::AppendKey:
+                scratch.key_scanner.Feed(character);
+
+                if (character != ' ' || !current_key.empty()) {
+                    current_key.push_back(character);
+                }
+
+                break;
+            case ScanAction::AppendValue:
+                scratch.value_scanner.Feed(character);
+
+                if (character != ' ' || !current_value.empty()) {
+                    current_value.push_back(character);
+                }
+
+                break;
+            case ScanAction::EndLine:
+                if (scratch.spans != nullptr) {
+                    RecordSpans(str, index, scratch);
+                }
+
+                failed = !Update(parser, options.limits, scratch);
+
+                break;
+            case ScanAction::Header: {
+                size_t header_begin = index;
+
+                failed = !ParseSections(str, ++index, options.limits.max_depth, current_sections);
+
+                if (!failed && !KeepSection(current_sections, scratch)) {
+                    index = SkipSection(str, index + 1, options.allow_includes, state) - 1;
+                } else if (!failed) {
+                    failed = !Charge(scratch, options.limits, 0, sizeof(omfl::Item) * current_sections.size() + index - header_begin);
+                }
+
+                current_key.clear();
+                current_value.clear();
+                scratch.key_scanner.Reset();
+                scratch.value_scanner.Reset();
 
                 break;
             }
+            case ScanAction::Fail:
+                failed = true;
 
-            continue;
+                break;
         }
+    }
+
+    scratch.state = state;
+
+    if (failed) {
+        parser.MarkUnsuccessful();
+    }
 
-        if (character == '#' && !in_string) {
-            ignore = true;
+    return (parser.valid() ? std::min(index, str.size()) : str.size());
+}
+
+bool KeepSection(const std::vector<std::string>& section_way, const ParseScratch& scratch) {
+    if (scratch.kept_sections.empty()) {
+        return true;
+    }
+
+    for (const auto& prefix: scratch.kept_sections) {
+        if (prefix.size() <= section_way.size() && std::equal(prefix.begin(), prefix.end(), section_way.begin())) {
+            return true;
         }
+    }
 
-        if (ignore) {
-            continue;
+    return false;
+}
+
+// Goes from the start of a line to the next bracket that opens a section
+// header, or to the end. Only lines holding a bracket are scanned, with the
+// same state machine as ParseRange, so that a header is found wherever the
+// scanner would open it, e.g. after a key as in `foo[keep]`, and state is
+// left as the scanner would have it at the bracket. The rest of the text is
+// passed over by the searches of find, which are vectorized memchr calls in
+// common standard libraries.
+size_t SkipSection(std::string_view str, size_t index, bool allow_includes, omfl::grammar::ScanState& state) {
+    using omfl::grammar::ScanAction;
+
+    while (index < str.size()) {
+        size_t open = str.find('[', index);
+
+        if (open == std::string_view::npos) {
+            break;
         }
 
-        if (character == '=' && !in_string) {
-            if (equal_sign_seen) {
-                parser.MarkUnsuccessful();
-                
+        size_t line_begin = str.rfind('\n', open);
+        line_begin = (line_begin == std::string_view::npos ? 0 : line_begin + 1);
+
+        bool key_empty = true;
+
+        state = omfl::grammar::ScanState::Key;
+
+        for (index = line_begin; index < str.size() && str[index] != '\n'; ++index) {
+            omfl::grammar::ScanStep step = omfl::grammar::Scan(state, str[index]);
+
+            if (step.action == ScanAction::Header) {
+                return index;
+            }
+
+            // An include takes the rest of its line, see ParseRange.
+            if (step.action == ScanAction::Include && allow_includes && key_empty) {
+                index = std::min(str.find('\n', index), str.size());
                 break;
             }
 
-            equal_sign_seen = true;
+            if ((step.action == ScanAction::AppendKey || step.action == ScanAction::Include) && str[index] != ' ') {
+                key_empty = false;
+            }
 
-            continue;
+            state = step.next;
         }
 
-        if (!equal_sign_seen) {
-            current_key.push_back(character);
-        } else {
-            if (character == '\"') {
-                in_string ^= 1;
-            }
+        ++index;
+    }
 
-            current_value.push_back(character);
-        }
+    state = omfl::grammar::ScanState::Key;
+
+    return str.size();
+}
+
+// Finds the parts of the line ending at line_end from the key and the value
+// gathered so far, before Update consumes them. Leading spaces were never
+// gathered, and the value runs up to the comment, if any.
+void RecordSpans(std::string_view str, size_t line_end, ParseScratch& scratch) {
+    const std::string& key = scratch.current_key;
+    const std::string& value = scratch.current_value;
+
+    if (key.empty() || value.empty()) {
+        return;
+    }
+
+    size_t line_begin = (line_end == 0 ? 0 : str.rfind('\n', line_end - 1) + 1);
+    omfl::EntrySpans spans;
+
+    spans.key.begin = str.find_first_not_of(' ', line_begin);
+    spans.key.end = spans.key.begin + key.find_last_not_of(' ') + 1;
+    spans.value.begin = str.find_first_not_of(' ', str.find('=', spans.key.end) + 1);
+    spans.value.end = spans.value.begin + value.find_last_not_of(' ') + 1;
+
+    size_t comment_begin = spans.value.begin + value.size();
+
+    if (comment_begin < line_end && str[comment_begin] == '#') {
+        spans.comment = {comment_begin, line_end};
+    } else {
+        spans.comment = {spans.value.end, spans.value.end};
+    }
+
+    for (const auto& section: scratch.current_sections) {
+        spans.path += section;
+        spans.path += '.';
     }
 
-    if ((!current_key.empty() || !current_value.empty()) && parser.valid()) {
-        if (!Update(parser, current_sections, current_key, current_value)) {
+    spans.path.append(str, spans.key.begin, spans.key.end - spans.key.begin);
+    scratch.spans->push_back(std::move(spans));
+}
+
+void FinishDocument(omfl::Parser& parser, const omfl::ParseOptions& options, ParseScratch& scratch) {
+    if ((!scratch.current_key.empty() || !scratch.current_value.empty()) && parser.valid()) {
+        if (!Update(parser, options.limits, scratch)) {
             parser.MarkUnsuccessful();
         }
     }
 
+    if (options.deduplicate && parser.valid()) {
+        parser.Deduplicate();
+    }
+}
+
+void ParseDocument(omfl::Parser& parser, std::string_view str, const omfl::ParseOptions& options, IncludeContext& includes, ParseScratch& scratch) {
+    if (!BeginDocument(parser, str, options, scratch)) {
+        return;
+    }
+
+    ParseRange(parser, str, 0, str.size(), options, includes, scratch);
+
+    if (scratch.spans != nullptr && parser.valid()) {
+        RecordSpans(str, str.size(), scratch);
+    }
+
+    FinishDocument(parser, options, scratch);
+}
+
+omfl::Parser omfl::parse(const std::filesystem::path& path, const ParseOptions& options) {
+    Parser parser;
+    std::string content;
+
+    if (!ReadFile(path, options.limits.max_bytes, content)) {
+        parser.MarkUnsuccessful();
+
+        return parser;
+    }
+
+    IncludeContext includes{path.parent_path(), {}, 0, {}};
+
+    if (options.allow_includes) {
+        includes.stack.push_back(std::filesystem::weakly_canonical(path));
+    }
+
+    ParseScratch scratch;
+
+    ParseDocument(parser, content, options, includes, scratch);
+
+    if (options.build_value_index && parser.valid()) {
+        parser.BuildValueIndex();
+    }
+
+    return parser;
+}
+
+omfl::Parser omfl::parse(const std::string& str, const ParseOptions& options) {
+    Parser parser;
+    IncludeContext includes;
+
+    ParseScratch scratch;
+
+    ParseDocument(parser, str, options, includes, scratch);
+
+    if (options.build_value_index && parser.valid()) {
+        parser.BuildValueIndex();
+    }
+
+    return parser;
+}
+
+omfl::Parser omfl::ParseWithSpans(std::string_view str, std::vector<EntrySpans>& spans, const ParseOptions& options) {
+    Parser parser;
+    IncludeContext includes;
+    ParseScratch scratch;
+
+    // At most one entry per line.
+    spans.reserve(spans.size() + std::count(str.begin(), str.end(), '\n') + 1);
+    scratch.spans = &spans;
+    ParseDocument(parser, str, options, includes, scratch);
+
+    if (options.build_value_index && parser.valid()) {
+        parser.BuildValueIndex();
+    }
+
+    return parser;
+}
+
+omfl::ParserContext::ParserContext()
+    : scratch_(std::make_unique<Scratch>())
+{}
+
+omfl::ParserContext::ParserContext(ParserContext&& other) noexcept = default;
+
+omfl::ParserContext& omfl::ParserContext::operator=(ParserContext&& other) noexcept = default;
+
+omfl::ParserContext::~ParserContext() = default;
+
+omfl::Parser omfl::ParserContext::Parse(std::string_view str, const ParseOptions& options) {
+    Parser parser;
+
+    Parse(str, parser, options);
+
     return parser;
 }
+
+void omfl::ParserContext::Parse(std::string_view str, Parser& parser, const ParseOptions& options) {
+    Begin(str, parser, options);
+    Resume(ParseLimits::kUnlimited);
+}
+
+void omfl::ParserContext::Begin(std::string_view str, Parser& parser, const ParseOptions& options, const std::filesystem::path& source) {
+    Scratch& scratch = *scratch_;
+
+    parser.Clear();
+
+    scratch.str = str;
+    scratch.parser = &parser;
+    scratch.options = options;
+    scratch.includes = IncludeContext{source.parent_path(), {}, 0, {}};
+    scratch.index = 0;
+
+    if (options.allow_includes && !source.empty()) {
+        scratch.includes.stack.push_back(std::filesystem::weakly_canonical(source));
+    }
+
+    if (!BeginDocument(parser, str, options, scratch)) {
+        scratch.index = str.size();
+    }
+}
+
+bool omfl::ParserContext::Resume(size_t bytes) {
+    Scratch& scratch = *scratch_;
+
+    if (scratch.parser == nullptr) {
+        return true;
+    }
+
+    Parser& parser = *scratch.parser;
+
+    try {
+        size_t stop = scratch.index + std::min(bytes, scratch.str.size() - scratch.index);
+
+        scratch.index = ParseRange(parser, scratch.str, scratch.index, stop, scratch.options, scratch.includes, scratch);
+
+        if (scratch.index < scratch.str.size()) {
+            return false;
+        }
+
+        FinishDocument(parser, scratch.options, scratch);
+    } catch (...) {
+        // The scratch buffers hold a half-parsed line; they are cleared on the next parse.
+        parser.MarkUnsuccessful();
+        scratch.parser = nullptr;
+
+        throw;
+    }
+
+    if (scratch.options.build_value_index && parser.valid()) {
+        parser.BuildValueIndex();
+    }
+
+    scratch.parser = nullptr;
+
+    return true;
+}
+
+std::vector<omfl::Parser> omfl::ParseBatch(std::span<const std::string_view> documents, const ParseOptions& options, size_t threads) {
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    threads = std::min(threads, std::max<size_t>(1, documents.size()));
+
+    std::vector<Parser> result(documents.size());
+    std::vector<ParserContext> contexts(threads);
+
+    ParallelFor(documents.size(), threads, [&](size_t worker, size_t index) {
+        try {
+            contexts[worker].Parse(documents[index], result[index], options);
+        } catch (const std::exception&) {
+            result[index].MarkUnsuccessful();
+        }
+    });
+
+    return result;
+}
+
+bool HasEmptySection(const omfl::SectionTable& section) {
+    std::vector<const omfl::SectionTable*> pending = {&section};
+
+    while (!pending.empty()) {
+        const omfl::SectionTable* current = pending.back();
+        pending.pop_back();
+
+        if (current->Size() == 0) {
+            return true;
+        }
+
+        for (const auto& item: *current) {
+            if (item.IsSection()) {
+                pending.push_back(&std::get<omfl::SectionTable>(item.GetValue()));
+            }
+        }
+    }
+
+    return false;
+}
@@ -1,12 +1,19 @@
 #pragma once
 
-#include <any>
+#include "inline_vector.h"
+
+#include <atomic>
 #include <cinttypes>
 #include <filesystem>
 #include <istream>
-#include <map>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
 #include <string_view>
 #include <utility>
+#include <variant>
 #include <vector>
 
 namespace omfl {
@@ -20,16 +27,254 @@ namespace omfl {
         Section
     };
 
+    class Item;
+    class ValueArray;
+    class SectionTable;
+    class ValueIndex;
+    struct MemoryReport;
+
+    // Alternatives follow the order of Type, so the index of the held value is its type.
+    using Value = std::variant<
+        std::monostate,
+        int32_t,
+        double,
+        std::string,
+        bool,
+        ValueArray,
+        SectionTable
+    >;
+
+    // Elements of a packed string array, viewed in place.
+    class StringViews {
+    public:
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::string_view*;
+            using reference = std::string_view;
+
+            Iterator(const StringViews* views, size_t index)
+                : views_(views)
+                , index_(index)
+            {}
+
+            std::string_view operator*() const {
+                return (*views_)[index_];
+            }
+
+            Iterator& operator++() {
+                ++index_;
+
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                Iterator previous = *this;
+                ++index_;
+
+                return previous;
+            }
+
+            bool operator==(const Iterator& other) const = default;
+        private:
+            const StringViews* views_;
+            size_t index_;
+        };
+
+        StringViews() = default;
+
+        StringViews(std::string_view chars, std::span<const uint32_t> ends)
+            : chars_(chars)
+            , ends_(ends)
+        {}
+
+        size_t Size() const {
+            return ends_.size();
+        }
+
+        std::string_view operator[](size_t index) const {
+            size_t begin = (index == 0 ? 0 : ends_[index - 1]);
+
+            return chars_.substr(begin, ends_[index] - begin);
+        }
+
+        Iterator begin() const {
+            return Iterator(this, 0);
+        }
+
+        Iterator end() const {
+            return Iterator(this, Size());
+        }
+    private:
+        std::string_view chars_;
+        std::span<const uint32_t> ends_;
+    };
+
+    class ValueArray {
+    public:
+        ValueArray();
+        ValueArray(const ValueArray& other);
+        ValueArray(ValueArray&& other) noexcept;
+        ValueArray& operator=(const ValueArray& other);
+        ValueArray& operator=(ValueArray&& other) noexcept;
+        ~ValueArray();
+
+        bool operator==(const ValueArray& other) const;
+
+        void Add(Value value, Type type);
+        const Item& Get(size_t index) const;
+        size_t Size() const;
+
+        const Item* begin() const;
+        const Item* end() const;
+
+        std::span<const int32_t> AsIntSpan() const;
+        std::span<const double> AsFloatSpan() const;
+        StringViews AsStringViews() const;
+        // Integer, Float or String for arrays packed as one of the spans above,
+        // Undefined for arrays stored as Items.
+        Type PackedType() const;
+
+        // Hash of the elements in order, kept up to date by Add.
+        uint64_t Hash() const;
+
+        // One level of Parser::MemoryUsage: returns the nested items left to visit.
+        std::span<const Item> CountMemory(MemoryReport& report) const;
+    private:
+        friend class SectionTable;
+
+        // Arrays whose elements all share a scalar type are kept packed,
+        // everything else is stored as a vector of Items.
+        struct PackedStrings {
+            std::string chars;
+            InlineVector<uint32_t, 4> ends;
+        };
+
+        using Storage = std::variant<
+            std::vector<Item>,
+            InlineVector<int32_t, 4>,
+            InlineVector<double, 2>,
+            PackedStrings
+        >;
+
+        void Unpack();
+        const std::vector<Item>& Items() const;
+
+        Storage storage_;
+        mutable std::atomic<std::vector<Item>*> unpacked_items_ = nullptr;
+        uint64_t hash_ = 0;
+    };
+
+    // Children of a section, kept contiguous in insertion order so that
+    // walking a section is a linear scan. Small sections are searched directly,
+    // larger ones through an open-addressing hash table of positions.
+    //
+    // Copies share the children and copy them on the first change, so copying
+    // a whole document is O(1) and changing a key copies only the sections on
+    // its path. Pointers obtained through the non-const accessors must not be
+    // kept across copies of the table.
+    class SectionTable {
+    public:
+        SectionTable() = default;
+        SectionTable(const SectionTable& other) = default;
+        SectionTable(SectionTable&& other) noexcept = default;
+        SectionTable& operator=(const SectionTable& other);
+        SectionTable& operator=(SectionTable&& other) noexcept;
+        ~SectionTable();
+
+        // Sections are equal when they hold equal items, regardless of their order.
+        bool operator==(const SectionTable& other) const;
+
+        Item* Find(std::string_view key);
+        const Item* Find(std::string_view key) const noexcept;
+        std::pair<Item*, bool> Insert(Item item);
+        void Clear();
+        size_t Size() const;
+
+        const Item* begin() const;
+        const Item* end() const;
+
+        // Hash of the items regardless of their order, kept up to date by Insert.
+        // A child changed in place, e.g. through Find, is accounted for by
+        // passing its hash before and after the change to UpdateChildHash.
+        uint64_t Hash() const;
+        void UpdateChildHash(uint64_t previous, uint64_t current);
+
+        // See ValueArray::CountMemory.
+        std::span<const Item> CountMemory(MemoryReport& report) const;
+
+        // Children that can be changed in place without affecting other
+        // tables, none while they are shared.
+        std::span<Item> OwnChildren();
+        // Shares the children of other when both tables hold equal items in
+        // the same order. Nested sections count as equal only when they share
+        // their children already.
+        bool ShareIfEqual(const SectionTable& other);
+    private:
+        friend class ValueArray;
+
+        static constexpr size_t kLinearScanLimit = 8;
+        static constexpr uint32_t kEmptySlot = UINT32_MAX;
+
+        struct Body {
+            std::vector<Item> items;
+            std::vector<uint32_t> index;
+        };
+
+        size_t FindSlot(std::string_view key) const noexcept;
+        void Rehash(size_t capacity);
+
+        // Whether no other table shares the children, which may then be
+        // changed in place. Copies of a table may live on other threads.
+        bool OwnsBody() const;
+        // Gives this table its own children before they are changed.
+        Body& Detach();
+
+        // Destroys nested sections and arrays with an explicit stack, so that
+        // tearing down a deep document does not grow the call stack. Sections
+        // shared with other tables are left to their last owner.
+        static void Release(std::vector<Item>& items);
+        void ReleaseBody();
+
+        // Null until the first item is inserted.
+        std::shared_ptr<Body> body_;
+        // Sum of the hashes of the items, which does not depend on their order.
+        uint64_t hash_sum_ = 0;
+    };
+
     class Item {
     public:
-        explicit Item(std::string_view _key, const std::any& _value, Type _value_type);
+        explicit Item(std::string_view _key, Value _value, Type _value_type);
+
+        bool operator==(const Item& other) const;
 
         const std::string& GetKey() const;
-        std::any& GetValue();
+        Value& GetValue();
+        const Value& GetValue() const;
         const Type GetType() const;
 
+        // Structural hash of the key and the value, covering everything below a
+        // section, so that equal items hash equally. UpdateHash recomputes it
+        // after the value was changed in place through GetValue.
+        uint64_t Hash() const;
+        void UpdateHash();
+
+        // See ValueArray::CountMemory.
+        std::span<const Item> CountMemory(MemoryReport& report) const;
+
         const Item& Get(std::string_view name) const;
         const Item& Get(const std::vector<std::string_view>& way, size_t index) const;
+
+        // Non-throwing lookups for optional keys. Find resolves a dotted path
+        // below this section and returns nullptr when any part is missing; the
+        // Get*Or helpers also fall back when the value has another type.
+        const Item* Find(std::string_view path) const noexcept;
+        int32_t GetIntOr(std::string_view path, int32_t value) const noexcept;
+        double GetFloatOr(std::string_view path, double value) const noexcept;
+        std::string_view GetStringOr(std::string_view path, std::string_view value) const noexcept;
+        bool GetBoolOr(std::string_view path, bool value) const noexcept;
         
         bool IsInt() const;
         int32_t AsInt() const;
@@ -48,45 +293,211 @@ namespace omfl {
         bool AsBoolOrDefault(bool value) const;
 
         bool IsArray() const;
+        bool IsSection() const;
         const Item& operator[](size_t index) const;
+        size_t Size() const;
+
+        const Item* begin() const;
+        const Item* end() const;
+
+        std::span<const int32_t> AsIntSpan() const;
+        std::span<const double> AsFloatSpan() const;
+        StringViews AsStringViews() const;
     private:
         std::string key;
-        std::any value;
+        Value value;
         Type value_type = Type::Undefined;
+        uint64_t hash = 0;
     };
 
-    class ValueArray {
-    public:
-        ValueArray();
+    // Bounds for documents from untrusted sources. Exceeding any of them fails
+    // the parse the same way a syntax error does. Everything is unlimited by default.
+    struct ParseLimits {
+        static constexpr size_t kUnlimited = std::numeric_limits<size_t>::max();
 
-        void Add(const std::any& value, Type type);
-        const Item& Get(size_t index) const;
-    private:
-        std::vector<Item> values_;
-        Item trash_item_;
+        // Size of each input, the document itself and every included file.
+        size_t max_bytes = kUnlimited;
+        // Nesting of sections and arrays: `[a.b]` is 2 deep, `[[1]]` inside it is 4.
+        size_t max_depth = kUnlimited;
+        size_t max_array_length = kUnlimited;
+        // Values stored in the document, including the ones spliced in by includes.
+        size_t max_keys = kUnlimited;
+        // Upper estimate of the memory held by the parsed tree, in bytes.
+        size_t max_memory = kUnlimited;
+    };
+
+    // Heap bytes held by a parsed document, see Parser::MemoryUsage.
+    struct MemoryReport {
+        // Keys too long to be kept inside their strings.
+        size_t keys = 0;
+        // String values, including the characters of packed string arrays.
+        size_t strings = 0;
+        // Array elements, and the Items built for indexed access to packed arrays.
+        size_t arrays = 0;
+        // Items held by sections and their lookup tables.
+        size_t sections = 0;
+        size_t value_index = 0;
+        // Capacity reserved beyond the above while the document was built.
+        size_t overhead = 0;
+
+        size_t Total() const;
+    };
+
+    struct ParseOptions {
+        // Builds a reverse index from scalar values to the keys holding them.
+        bool build_value_index = false;
+        // Stores repeated sections once, see Parser::Deduplicate.
+        bool deduplicate = false;
+
+        // Enables `@include "path"` lines, which splice another file into the
+        // current section. Relative paths are resolved against the including file.
+        bool allow_includes = false;
+        size_t max_include_depth = 16;
+
+        ParseLimits limits;
+
+        // Keeps only the sections whose path starts with one of these, e.g.
+        // "servers.alpha" keeps [servers.alpha] and [servers.alpha.tls] but not
+        // [servers] or the keys above the first header. Headers are still
+        // checked, but the lines of other sections are skipped unchecked up to
+        // the next line opening with `[`. Everything is kept when empty.
+        std::vector<std::string> sections;
     };
 
     class Parser {
     public:
+        bool operator==(const Parser& other) const;
+
         bool valid() const;
         void MarkUnsuccessful();
 
-        bool Add(const std::vector<std::string>& section_way, const Item& appending_item);
+        // Drops all items, keeping the capacity of the top-level section.
+        void Clear();
+
+        bool Add(const std::vector<std::string>& section_way, Item appending_item);
+
+        // Sets the value under a dotted path, creating the sections leading to
+        // it and replacing whatever the path held. Copies of a Parser share
+        // their sections, so only the sections along the path are copied.
+        // Drops the value index, which would be stale afterwards. Throws for
+        // empty sections, which parsing never produces.
+        void Set(std::string_view name, Value value);
+
         const Item& Get(std::string_view name) const;
+        Item& GetRoot();
+        const Item& GetRoot() const;
+
+        // See Item::Find.
+        const Item* Find(std::string_view path) const noexcept;
+        int32_t GetIntOr(std::string_view path, int32_t value) const noexcept;
+        double GetFloatOr(std::string_view path, double value) const noexcept;
+        std::string_view GetStringOr(std::string_view path, std::string_view value) const noexcept;
+        bool GetBoolOr(std::string_view path, bool value) const noexcept;
+
+        // Matches dotted patterns where "*" stands for any single key and
+        // "**" for any number of nested sections, e.g. "servers.*.enabled".
+        std::vector<const Item*> Query(std::string_view pattern) const;
+
+        // Fully qualified keys holding the value, either directly or as an array element.
+        // Requires the value index, see ParseOptions::build_value_index.
+        void BuildValueIndex();
+        bool HasValueIndex() const;
+        size_t ValueIndexMemoryUsage() const;
+        const std::vector<std::string>& KeysWithValue(int32_t value) const;
+        const std::vector<std::string>& KeysWithValue(double value) const;
+        const std::vector<std::string>& KeysWithValue(bool value) const;
+        const std::vector<std::string>& KeysWithValue(std::string_view value) const;
+        const std::vector<std::string>& KeysWithValue(const char* value) const;
+
+        // Sections shared within the tree are counted once, sections shared
+        // with copies of this Parser in full.
+        // See omfl::Freeze for a compact read-only copy of the tree.
+        MemoryReport MemoryUsage() const;
+        // Makes sections holding equal items in the same order share them, so
+        // that repeated subtrees, e.g. [servers.*] blocks differing only in
+        // their name, are stored once. A shared section is copied on its first
+        // change, see Set. Invalidates references to items.
+        void Deduplicate();
+
+        // Calls visitor(item, depth) for every section and value, parents before children.
+        template <typename Visitor>
+        void Visit(Visitor&& visitor) const {
+            // Sibling ranges still to be visited, one per open section.
+            std::vector<std::pair<const Item*, const Item*>> ranges = {{tree_.GetRoot().begin(), tree_.GetRoot().end()}};
+
+            while (!ranges.empty()) {
+                auto& [current, last] = ranges.back();
+
+                if (current == last) {
+                    ranges.pop_back();
+
+                    continue;
+                }
+
+                const Item& item = *current++;
+
+                visitor(item, ranges.size() - 1);
+
+                if (item.IsSection()) {
+                    ranges.emplace_back(item.begin(), item.end());
+                }
+            }
+        }
     private:
         class Trie {
         public:
             Trie();
         
-            bool AddItem(const std::vector<std::string>& section_way, const Item& appending_item);
+            bool AddItem(const std::vector<std::string>& section_way, Item appending_item);
+            void SetItem(const std::vector<std::string_view>& way, Item item);
+            void Clear();
             const Item& GetItem(std::string_view name) const;
+            Item& GetRoot();
+            const Item& GetRoot() const;
         private:
+            // Refreshes the hashes of the sections on a path from the root down,
+            // after an item below the last of them changed.
+            void UpdateHashes(std::span<Item* const> way);
+
             Item root_;
         } tree_;
 
+        std::shared_ptr<const ValueIndex> value_index_;
         bool successful_parse_ = true;
     };
 
-    Parser parse(const std::filesystem::path& path);
-    Parser parse(const std::string& str);
+    Parser parse(const std::filesystem::path& path, const ParseOptions& options = {});
+    Parser parse(const std::string& str, const ParseOptions& options = {});
+
+    // Scratch state of the parse loop. Reusing one context across parses keeps the
+    // grown capacity of its buffers, so parsing a stream of similar documents does
+    // not reallocate them. A context must not be used by two threads at once.
+    class ParserContext {
+    public:
+        ParserContext();
+        ParserContext(ParserContext&& other) noexcept;
+        ParserContext& operator=(ParserContext&& other) noexcept;
+        ~ParserContext();
+
+        Parser Parse(std::string_view str, const ParseOptions& options = {});
+
+        // Parses into an existing Parser, replacing its contents.
+        void Parse(std::string_view str, Parser& parser, const ParseOptions& options = {});
+
+        // Resumable form of Parse for callers that interleave parsing with other
+        // work. Begin binds the document and the result, then each Resume parses
+        // about `bytes` more of it and returns true once the parse is complete.
+        // str must stay alive until then. Relative includes resolve against the
+        // directory of `source`, the file the document was read from.
+        void Begin(std::string_view str, Parser& parser, const ParseOptions& options = {}, const std::filesystem::path& source = {});
+        bool Resume(size_t bytes);
+    private:
+        struct Scratch;
+
+        std::unique_ptr<Scratch> scratch_;
+    };
+
+    // Parses independent documents on `threads` workers (all cores when 0).
+    // Results come back in input order; a document that fails to parse yields an invalid Parser.
+    std::vector<Parser> ParseBatch(std::span<const std::string_view> documents, const ParseOptions& options = {}, size_t threads = 0);
 }
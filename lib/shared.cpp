@@ -0,0 +1,630 @@
+#include "shared.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Offsets in the image are relative to its start, so it can be mapped at any
+// address. Children of a section or an array are contiguous nodes, laid out
+// breadth first.
+struct omfl::SharedNode {
+    uint64_t key_begin = 0;
+    uint32_t key_size = 0;
+    Type type = Type::Undefined;
+    // Bits of a scalar, the characters of a string, or the first child node.
+    uint64_t begin = 0;
+    uint64_t size = 0;
+    // Hash table of the children of a large section in the lookups, see LookupSlots.
+    uint64_t lookup = 0;
+};
+
+// The segment under the published name, pointing at the current generation.
+// Generation 0 means that nothing was published yet. Magic is set only after
+// the first generation, so a reader that sees it also sees a generation.
+struct omfl::SharedControl {
+    std::atomic<uint64_t> magic;
+    std::atomic<uint64_t> generation;
+};
+
+namespace {
+    // "OMFLSHM" and a version of the layout, bumped whenever it changes.
+    constexpr uint64_t kImageMagic = 0x014d48534c464d4f;
+    constexpr uint64_t kControlMagic = 0x434d48534c464d4f;
+    constexpr size_t kLinearScanLimit = 8;
+    constexpr uint32_t kEmptySlot = UINT32_MAX;
+
+    // Fixed, unlike std::hash, so that every process finds the same slots.
+    uint64_t HashKey(std::string_view key) {
+        uint64_t result = 0xcbf29ce484222325;
+
+        for (char character: key) {
+            result = (result ^ static_cast<uint8_t>(character)) * 0x100000001b3;
+        }
+
+        return result;
+    }
+
+    // Open-addressing table of child positions, at most half full.
+    size_t LookupSlots(size_t children) {
+        return std::bit_ceil(children * 2);
+    }
+
+    struct SharedHeader {
+        uint64_t magic;
+        uint64_t generation;
+        uint64_t size;
+        uint64_t nodes;
+        uint64_t lookups;
+        uint64_t chars;
+    };
+
+    // Flattens a tree into the three regions of an image.
+    struct ImageBuilder {
+        std::vector<omfl::SharedNode> nodes;
+        std::vector<uint32_t> lookups;
+        std::string chars;
+
+        void Build(const omfl::Item& root) {
+            nodes.push_back(MakeNode(root));
+
+            // Sections and arrays whose children are still to be laid out, with their node.
+            std::vector<std::pair<size_t, const omfl::Item*>> pending = {{0, &root}};
+
+            for (size_t next = 0; next < pending.size(); ++next) {
+                auto [position, item] = pending[next];
+
+                nodes[position].begin = nodes.size();
+                nodes[position].size = item->Size();
+
+                if (item->IsArray() && AddPacked(std::get<omfl::ValueArray>(item->GetValue()))) {
+                    continue;
+                }
+
+                for (const auto& child: *item) {
+                    if (child.IsSection() || child.IsArray()) {
+                        pending.emplace_back(nodes.size(), &child);
+                    }
+
+                    nodes.push_back(MakeNode(child));
+                }
+
+                if (item->IsSection() && item->Size() > kLinearScanLimit) {
+                    size_t mask = LookupSlots(item->Size()) - 1;
+
+                    nodes[position].lookup = lookups.size();
+                    lookups.resize(lookups.size() + mask + 1, kEmptySlot);
+
+                    uint32_t* slots = lookups.data() + nodes[position].lookup;
+
+                    for (uint32_t i = 0; i < item->Size(); ++i) {
+                        size_t slot = HashKey(item->begin()[i].GetKey()) & mask;
+
+                        while (slots[slot] != kEmptySlot) {
+                            slot = (slot + 1) & mask;
+                        }
+
+                        slots[slot] = i;
+                    }
+                }
+            }
+        }
+
+        // Lays out the elements of a packed array from its spans, which unlike
+        // its Items do not have to be built first. False for other arrays.
+        bool AddPacked(const omfl::ValueArray& array) {
+            switch (array.PackedType()) {
+                case omfl::Type::Integer:
+                    for (int32_t value: array.AsIntSpan()) {
+                        nodes.push_back(MakeNode("", omfl::Type::Integer));
+                        nodes.back().begin = static_cast<uint32_t>(value);
+                    }
+
+                    return true;
+                case omfl::Type::Float:
+                    for (double value: array.AsFloatSpan()) {
+                        nodes.push_back(MakeNode("", omfl::Type::Float));
+                        nodes.back().begin = std::bit_cast<uint64_t>(value);
+                    }
+
+                    return true;
+                case omfl::Type::String:
+                    for (std::string_view value: array.AsStringViews()) {
+                        nodes.push_back(MakeNode("", omfl::Type::String));
+                        AddString(nodes.back(), value);
+                    }
+
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        omfl::SharedNode MakeNode(std::string_view key, omfl::Type type) {
+            omfl::SharedNode node;
+
+            node.key_begin = chars.size();
+            node.key_size = key.size();
+            node.type = type;
+            chars += key;
+
+            return node;
+        }
+
+        omfl::SharedNode MakeNode(const omfl::Item& item) {
+            omfl::SharedNode node = MakeNode(item.GetKey(), item.GetType());
+
+            switch (item.GetType()) {
+                case omfl::Type::Integer:
+                    node.begin = static_cast<uint32_t>(item.AsInt());
+                    break;
+                case omfl::Type::Float:
+                    node.begin = std::bit_cast<uint64_t>(item.AsFloat());
+                    break;
+                case omfl::Type::String:
+                    AddString(node, item.AsString());
+                    break;
+                case omfl::Type::Boolean:
+                    node.begin = item.AsBool();
+                    break;
+                default:
+                    break;
+            }
+
+            return node;
+        }
+
+        void AddString(omfl::SharedNode& node, std::string_view value) {
+            node.begin = chars.size();
+            node.size = value.size();
+            chars += value;
+        }
+
+        SharedHeader MakeHeader(uint64_t generation) const {
+            SharedHeader header{kImageMagic, generation, 0, sizeof(SharedHeader), 0, 0};
+
+            header.lookups = header.nodes + nodes.size() * sizeof(omfl::SharedNode);
+            header.chars = header.lookups + lookups.size() * sizeof(uint32_t);
+            header.size = header.chars + chars.size();
+
+            return header;
+        }
+
+        // Writes the image described by header into data, header.size bytes.
+        void Write(const SharedHeader& header, std::byte* data) const {
+            std::memcpy(data, &header, sizeof(header));
+            std::memcpy(data + header.nodes, nodes.data(), nodes.size() * sizeof(omfl::SharedNode));
+            std::memcpy(data + header.lookups, lookups.data(), lookups.size() * sizeof(uint32_t));
+            std::memcpy(data + header.chars, chars.data(), chars.size());
+        }
+    };
+
+    // Unmaps a segment when leaving the scope that mapped it.
+    struct Mapping {
+        Mapping() = default;
+
+        Mapping(Mapping&& other) noexcept
+            : data(std::exchange(other.data, nullptr))
+            , size(std::exchange(other.size, 0))
+        {}
+
+        Mapping& operator=(Mapping&& other) = delete;
+
+        ~Mapping() {
+            if (data != nullptr) {
+                ::munmap(data, size);
+            }
+        }
+
+        void* data = nullptr;
+        size_t size = 0;
+    };
+
+    // Maps a whole segment, first creating it with `size` bytes when the flags
+    // hold O_CREAT. Leaves data null and errno set on failure.
+    Mapping MapSegment(const std::string& name, int flags, size_t size = 0) {
+        Mapping result;
+        int fd = ::shm_open(name.c_str(), flags, 0644);
+
+        if (fd < 0) {
+            return result;
+        }
+
+        struct stat status{};
+
+        if (((flags & O_CREAT) == 0 || ::ftruncate(fd, size) == 0) && ::fstat(fd, &status) == 0 && status.st_size > 0) {
+            int protection = ((flags & O_ACCMODE) == O_RDONLY ? PROT_READ : PROT_READ | PROT_WRITE);
+            void* data = ::mmap(nullptr, status.st_size, protection, MAP_SHARED, fd, 0);
+
+            if (data != MAP_FAILED) {
+                result.data = data;
+                result.size = status.st_size;
+            }
+        }
+
+        int error = errno;
+        ::close(fd);
+        errno = error;
+
+        return result;
+    }
+
+    std::string SegmentName(const std::string& name, uint64_t generation) {
+        return name + "." + std::to_string(generation);
+    }
+
+    const SharedHeader& GetHeader(const std::byte* image) {
+        return *reinterpret_cast<const SharedHeader*>(image);
+    }
+
+    const omfl::SharedNode* GetNodes(const std::byte* image) {
+        return reinterpret_cast<const omfl::SharedNode*>(image + GetHeader(image).nodes);
+    }
+
+    const omfl::SharedNode& UndefinedNode() {
+        static const omfl::SharedNode undefined_node;
+
+        return undefined_node;
+    }
+}
+
+omfl::SharedItem::SharedItem(const std::byte* image, const SharedNode* node)
+    : image_(image)
+    , node_(node)
+{}
+
+std::string_view omfl::SharedItem::GetKey() const {
+    const char* chars = reinterpret_cast<const char*>(image_ + GetHeader(image_).chars);
+
+    return std::string_view(chars + node_->key_begin, node_->key_size);
+}
+
+omfl::Type omfl::SharedItem::GetType() const {
+    return node_->type;
+}
+
+omfl::SharedItem omfl::SharedItem::Get(std::string_view name) const {
+    std::optional<SharedItem> item = Find(name);
+
+    if (!item.has_value()) {
+        throw std::runtime_error("Addressing to an non-existing key/section.");
+    }
+
+    return *item;
+}
+
+std::optional<omfl::SharedItem> omfl::SharedItem::Find(std::string_view path) const {
+    const SharedNode* current = node_;
+
+    while (true) {
+        size_t end = std::min(path.find('.'), path.size());
+
+        current = SharedItem(image_, current).FindChild(path.substr(0, end));
+
+        if (current == nullptr) {
+            return std::nullopt;
+        }
+
+        if (end == path.size()) {
+            return SharedItem(image_, current);
+        }
+
+        path.remove_prefix(end + 1);
+    }
+}
+
+bool omfl::SharedItem::IsInt() const {
+    return node_->type == Type::Integer;
+}
+
+int32_t omfl::SharedItem::AsInt() const {
+    Expect(Type::Integer);
+
+    return static_cast<int32_t>(node_->begin);
+}
+
+int32_t omfl::SharedItem::AsIntOrDefault(int32_t value) const {
+    return (IsInt() ? AsInt() : value);
+}
+
+bool omfl::SharedItem::IsFloat() const {
+    return node_->type == Type::Float;
+}
+
+double omfl::SharedItem::AsFloat() const {
+    Expect(Type::Float);
+
+    return std::bit_cast<double>(node_->begin);
+}
+
+double omfl::SharedItem::AsFloatOrDefault(double value) const {
+    return (IsFloat() ? AsFloat() : value);
+}
+
+bool omfl::SharedItem::IsString() const {
+    return node_->type == Type::String;
+}
+
+std::string_view omfl::SharedItem::AsString() const {
+    Expect(Type::String);
+
+    const char* chars = reinterpret_cast<const char*>(image_ + GetHeader(image_).chars);
+
+    return std::string_view(chars + node_->begin, node_->size);
+}
+
+std::string_view omfl::SharedItem::AsStringOrDefault(std::string_view value) const {
+    return (IsString() ? AsString() : value);
+}
+
+bool omfl::SharedItem::IsBool() const {
+    return node_->type == Type::Boolean;
+}
+
+bool omfl::SharedItem::AsBool() const {
+    Expect(Type::Boolean);
+
+    return node_->begin != 0;
+}
+
+bool omfl::SharedItem::AsBoolOrDefault(bool value) const {
+    return (IsBool() ? AsBool() : value);
+}
+
+bool omfl::SharedItem::IsArray() const {
+    return node_->type == Type::Array;
+}
+
+bool omfl::SharedItem::IsSection() const {
+    return node_->type == Type::Section;
+}
+
+size_t omfl::SharedItem::Size() const {
+    if (!IsArray() && !IsSection()) {
+        throw std::runtime_error("Trying to access non-accessible value.");
+    }
+
+    return node_->size;
+}
+
+omfl::SharedItem omfl::SharedItem::operator[](size_t index) const {
+    if (index >= Size()) {
+        return SharedItem(image_, &UndefinedNode());
+    }
+
+    return SharedItem(image_, GetNodes(image_) + node_->begin + index);
+}
+
+const omfl::SharedNode* omfl::SharedItem::FindChild(std::string_view key) const {
+    if (!IsSection()) {
+        return nullptr;
+    }
+
+    const SharedNode* children = GetNodes(image_) + node_->begin;
+    auto key_of = [this](const SharedNode& node) {
+        return SharedItem(image_, &node).GetKey();
+    };
+
+    if (node_->size <= kLinearScanLimit) {
+        for (size_t i = 0; i < node_->size; ++i) {
+            if (key_of(children[i]) == key) {
+                return children + i;
+            }
+        }
+
+        return nullptr;
+    }
+
+    const auto* slots = reinterpret_cast<const uint32_t*>(image_ + GetHeader(image_).lookups) + node_->lookup;
+    size_t mask = LookupSlots(node_->size) - 1;
+
+    for (size_t slot = HashKey(key) & mask; slots[slot] != kEmptySlot; slot = (slot + 1) & mask) {
+        if (key_of(children[slots[slot]]) == key) {
+            return children + slots[slot];
+        }
+    }
+
+    return nullptr;
+}
+
+void omfl::SharedItem::Expect(Type type) const {
+    if (node_->type != type) {
+        throw std::runtime_error("Trying to access non-accessible value.");
+    }
+}
+
+omfl::SharedConfig::SharedConfig(const std::byte* image, size_t size, const SharedControl* control)
+    : image_(image)
+    , size_(size)
+    , control_(control)
+{}
+
+omfl::SharedConfig::SharedConfig(SharedConfig&& other) noexcept
+    : image_(std::exchange(other.image_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+    , control_(std::exchange(other.control_, nullptr))
+{}
+
+omfl::SharedConfig& omfl::SharedConfig::operator=(SharedConfig&& other) noexcept {
+    if (this != &other) {
+        std::swap(image_, other.image_);
+        std::swap(size_, other.size_);
+        std::swap(control_, other.control_);
+    }
+
+    return *this;
+}
+
+omfl::SharedConfig::~SharedConfig() {
+    if (image_ != nullptr) {
+        ::munmap(const_cast<std::byte*>(image_), size_);
+        ::munmap(const_cast<SharedControl*>(control_), sizeof(SharedControl));
+    }
+}
+
+uint64_t omfl::SharedConfig::Publish(const Parser& parser, const std::string& name) {
+    if (!parser.valid()) {
+        throw std::runtime_error("Cannot publish an invalid document.");
+    }
+
+    ImageBuilder builder;
+
+    builder.Build(parser.GetRoot());
+
+    Mapping control = MapSegment(name, O_RDWR | O_CREAT, sizeof(SharedControl));
+
+    if (control.data == nullptr) {
+        throw std::runtime_error("Cannot open shared memory segment " + name + ": " + std::strerror(errno));
+    }
+
+    auto* current = static_cast<SharedControl*>(control.data);
+
+    SharedHeader header = builder.MakeHeader(current->generation.load(std::memory_order_acquire) + 1);
+
+    std::string segment = SegmentName(name, header.generation);
+
+    // Left behind by a publisher that failed halfway, if anything.
+    ::shm_unlink(segment.c_str());
+
+    Mapping image = MapSegment(segment, O_RDWR | O_CREAT | O_EXCL, header.size);
+
+    if (image.data == nullptr) {
+        throw std::runtime_error("Cannot create shared memory segment " + segment + ": " + std::strerror(errno));
+    }
+
+    builder.Write(header, static_cast<std::byte*>(image.data));
+
+    // Readers that already mapped the previous generation keep it after the unlink.
+    uint64_t previous = current->generation.exchange(header.generation, std::memory_order_acq_rel);
+
+    current->magic.store(kControlMagic, std::memory_order_release);
+
+    if (previous != 0) {
+        ::shm_unlink(SegmentName(name, previous).c_str());
+    }
+
+    return header.generation;
+}
+
+omfl::SharedConfig omfl::SharedConfig::Attach(const std::string& name) {
+    Mapping control = MapSegment(name, O_RDONLY);
+    const auto* current = static_cast<const SharedControl*>(control.data);
+
+    // A first Publish may not have finished yet.
+    if (
+        current == nullptr || control.size < sizeof(SharedControl) ||
+        current->magic.load(std::memory_order_acquire) != kControlMagic ||
+        current->generation.load(std::memory_order_acquire) == 0
+    ) {
+        throw std::runtime_error("Nothing is published as " + name + ".");
+    }
+
+    while (true) {
+        uint64_t generation = current->generation.load(std::memory_order_acquire);
+        Mapping image = MapSegment(SegmentName(name, generation), O_RDONLY);
+
+        if (image.data != nullptr) {
+            const auto& header = GetHeader(static_cast<const std::byte*>(image.data));
+
+            if (image.size < sizeof(SharedHeader) || header.magic != kImageMagic || header.size > image.size) {
+                throw std::runtime_error("Shared memory segment of " + name + " does not hold a published document.");
+            }
+
+            SharedConfig result(static_cast<const std::byte*>(std::exchange(image.data, nullptr)), image.size, current);
+
+            control.data = nullptr;
+
+            return result;
+        }
+
+        // The generation may have been replaced and unlinked in the meantime.
+        if (errno != ENOENT || current->generation.load(std::memory_order_acquire) == generation) {
+            throw std::runtime_error("Cannot attach to " + name + ": " + std::strerror(errno));
+        }
+    }
+}
+
+void omfl::SharedConfig::Remove(const std::string& name) {
+    Mapping control = MapSegment(name, O_RDONLY);
+
+    if (control.data != nullptr && control.size >= sizeof(SharedControl)) {
+        uint64_t generation = static_cast<const SharedControl*>(control.data)->generation.load(std::memory_order_acquire);
+
+        ::shm_unlink(SegmentName(name, generation).c_str());
+    }
+
+    ::shm_unlink(name.c_str());
+}
+
+uint64_t omfl::SharedConfig::Generation() const {
+    return GetHeader(image_).generation;
+}
+
+bool omfl::SharedConfig::IsCurrent() const {
+    return control_->generation.load(std::memory_order_acquire) == Generation();
+}
+
+omfl::SharedItem omfl::SharedConfig::GetRoot() const {
+    return SharedItem(image_, GetNodes(image_));
+}
+
+omfl::SharedItem omfl::SharedConfig::Get(std::string_view name) const {
+    return GetRoot().Get(name);
+}
+
+std::optional<omfl::SharedItem> omfl::SharedConfig::Find(std::string_view path) const {
+    return GetRoot().Find(path);
+}
+
+size_t omfl::SharedConfig::ImageSize() const {
+    return size_;
+}
+
+omfl::FrozenConfig::FrozenConfig(std::unique_ptr<std::byte[]> image, size_t size)
+    : image_(std::move(image))
+    , size_(size)
+{}
+
+omfl::SharedItem omfl::FrozenConfig::GetRoot() const {
+    return SharedItem(image_.get(), GetNodes(image_.get()));
+}
+
+omfl::SharedItem omfl::FrozenConfig::Get(std::string_view name) const {
+    return GetRoot().Get(name);
+}
+
+std::optional<omfl::SharedItem> omfl::FrozenConfig::Find(std::string_view path) const {
+    return GetRoot().Find(path);
+}
+
+size_t omfl::FrozenConfig::ImageSize() const {
+    return size_;
+}
+
+omfl::FrozenConfig omfl::Freeze(const Parser& parser) {
+    if (!parser.valid()) {
+        throw std::runtime_error("Cannot freeze an invalid document.");
+    }
+
+    ImageBuilder builder;
+
+    builder.Build(parser.GetRoot());
+
+    SharedHeader header = builder.MakeHeader(0);
+    // new[] aligns the buffer for the nodes, as mmap does for published images.
+    auto image = std::make_unique<std::byte[]>(header.size);
+
+    builder.Write(header, image.get());
+
+    return FrozenConfig(std::move(image), header.size);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "parser.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace omfl {
+    struct SharedNode;
+    struct SharedControl;
+
+    // A value or section of a published or frozen document, read in place from its image.
+    class SharedItem {
+    public:
+        std::string_view GetKey() const;
+        Type GetType() const;
+
+        SharedItem Get(std::string_view name) const;
+        std::optional<SharedItem> Find(std::string_view path) const;
+
+        bool IsInt() const;
+        int32_t AsInt() const;
+        int32_t AsIntOrDefault(int32_t value) const;
+
+        bool IsFloat() const;
+        double AsFloat() const;
+        double AsFloatOrDefault(double value) const;
+
+        bool IsString() const;
+        std::string_view AsString() const;
+        std::string_view AsStringOrDefault(std::string_view value) const;
+
+        bool IsBool() const;
+        bool AsBool() const;
+        bool AsBoolOrDefault(bool value) const;
+
+        bool IsArray() const;
+        bool IsSection() const;
+        size_t Size() const;
+
+        // Elements of an array, or children of a section in insertion order.
+        SharedItem operator[](size_t index) const;
+    private:
+        friend class SharedConfig;
+        friend class FrozenConfig;
+
+        SharedItem(const std::byte* image, const SharedNode* node);
+
+        const SharedNode* FindChild(std::string_view key) const;
+        void Expect(Type type) const;
+
+        const std::byte* image_;
+        const SharedNode* node_;
+    };
+
+    // A document published once per host into POSIX shared memory, which any
+    // number of processes map read-only instead of parsing their own copy.
+    //
+    // Every Publish writes a new generation into its own segment, then makes
+    // it the current one under `name`, e.g. "/app-config". Processes attached
+    // to an older generation keep reading it until they attach again; its
+    // memory is returned once the last of them lets go. Publishing is meant to
+    // be done by a single process at a time.
+    class SharedConfig {
+    public:
+        SharedConfig(SharedConfig&& other) noexcept;
+        SharedConfig& operator=(SharedConfig&& other) noexcept;
+        ~SharedConfig();
+
+        // Returns the generation the document was published as.
+        static uint64_t Publish(const Parser& parser, const std::string& name);
+        static SharedConfig Attach(const std::string& name);
+
+        // Removes the name; attached processes keep their mappings.
+        static void Remove(const std::string& name);
+
+        uint64_t Generation() const;
+        // False once a newer generation was published under the same name.
+        bool IsCurrent() const;
+
+        SharedItem GetRoot() const;
+        SharedItem Get(std::string_view name) const;
+        std::optional<SharedItem> Find(std::string_view path) const;
+
+        // Bytes of the mapped image, shared by every attached process.
+        size_t ImageSize() const;
+    private:
+        SharedConfig(const std::byte* image, size_t size, const SharedControl* control);
+
+        const std::byte* image_ = nullptr;
+        size_t size_ = 0;
+        const SharedControl* control_ = nullptr;
+    };
+
+    // A document compacted into the image Publish writes, held by this
+    // process alone: every value is a fixed-size node and every key and
+    // string lives in one buffer, with nothing left over from parsing.
+    class FrozenConfig {
+    public:
+        SharedItem GetRoot() const;
+        SharedItem Get(std::string_view name) const;
+        std::optional<SharedItem> Find(std::string_view path) const;
+
+        size_t ImageSize() const;
+    private:
+        friend FrozenConfig Freeze(const Parser& parser);
+
+        FrozenConfig(std::unique_ptr<std::byte[]> image, size_t size);
+
+        std::unique_ptr<std::byte[]> image_;
+        size_t size_ = 0;
+    };
+
+    // Builds the read-only image of a finished document, which stays valid
+    // independently of the parser.
+    FrozenConfig Freeze(const Parser& parser);
+}
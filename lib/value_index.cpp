@@ -0,0 +1,201 @@
+#include "value_index.h"
+
+#include <cstring>
+#include <tuple>
+
+std::string MakeIndexKey(char tag, const void* data, size_t size);
+std::string MakeIndexKey(const omfl::Item& item);
+size_t HeapBytes(const std::string& str);
+
+std::string MakeIndexKey(char tag, const void* data, size_t size) {
+    std::string result(1, tag);
+
+    result.append(static_cast<const char*>(data), size);
+
+    return result;
+}
+
+std::string MakeIndexKey(const omfl::Item& item) {
+    if (item.IsInt()) {
+        int32_t value = item.AsInt();
+
+        return MakeIndexKey('i', &value, sizeof(value));
+    } else if (item.IsFloat()) {
+        // +0.0 and -0.0 compare equal, so they share an entry.
+        double value = item.AsFloat() + 0.0;
+
+        return MakeIndexKey('f', &value, sizeof(value));
+    } else if (item.IsBool()) {
+        bool value = item.AsBool();
+
+        return MakeIndexKey('b', &value, sizeof(value));
+    }
+
+    std::string_view value = item.AsString();
+
+    return MakeIndexKey('s', value.data(), value.size());
+}
+
+size_t HeapBytes(const std::string& str) {
+    const char* object = reinterpret_cast<const char*>(&str);
+
+    if (str.data() >= object && str.data() < object + sizeof(str)) {
+        return 0;
+    }
+
+    return str.capacity() + 1;
+}
+
+omfl::ValueIndex::ValueIndex(const Item& root) {
+    std::string path;
+
+    AddSection(root, path);
+}
+
+const std::vector<std::string>& omfl::ValueIndex::Find(int32_t value) const {
+    return Find(MakeIndexKey('i', &value, sizeof(value)));
+}
+
+const std::vector<std::string>& omfl::ValueIndex::Find(double value) const {
+    value += 0.0;
+
+    return Find(MakeIndexKey('f', &value, sizeof(value)));
+}
+
+const std::vector<std::string>& omfl::ValueIndex::Find(bool value) const {
+    return Find(MakeIndexKey('b', &value, sizeof(value)));
+}
+
+const std::vector<std::string>& omfl::ValueIndex::Find(std::string_view value) const {
+    return Find(MakeIndexKey('s', value.data(), value.size()));
+}
+
+size_t omfl::ValueIndex::MemoryUsage() const {
+    size_t result = sizeof(*this) + keys_.bucket_count() * sizeof(void*);
+
+    for (const auto& [index_key, keys]: keys_) {
+        // Hash node: next pointer, cached hash and the pair itself.
+        result += 2 * sizeof(void*) + sizeof(std::pair<const std::string, std::vector<std::string>>);
+        result += HeapBytes(index_key);
+        result += keys.capacity() * sizeof(std::string);
+
+        for (const auto& key: keys) {
+            result += HeapBytes(key);
+        }
+    }
+
+    return result;
+}
+
+void omfl::ValueIndex::AddSection(const Item& section, std::string& path) {
+    // Children left to visit, one range per section on the path, each with
+    // the length of the path leading to it.
+    std::vector<std::tuple<const Item*, const Item*, size_t>> ranges = {{section.begin(), section.end(), path.size()}};
+
+    while (!ranges.empty()) {
+        auto& [next, end, path_size] = ranges.back();
+
+        if (next == end) {
+            ranges.pop_back();
+            continue;
+        }
+
+        const Item& child = *next++;
+
+        path.resize(path_size);
+
+        if (!path.empty()) {
+            path += '.';
+        }
+
+        path += child.GetKey();
+
+        if (child.IsSection()) {
+            ranges.emplace_back(child.begin(), child.end(), path.size());
+        } else {
+            AddValue(child, path);
+        }
+    }
+}
+
+void omfl::ValueIndex::AddValue(const Item& item, const std::string& path) {
+    if (!item.IsArray()) {
+        AddKey(MakeIndexKey(item), path);
+
+        return;
+    }
+
+    // Nested arrays are walked with an explicit stack, as deep as the parser accepts them.
+    std::vector<std::pair<const Item*, const Item*>> ranges;
+    const auto* array = &std::get<ValueArray>(item.GetValue());
+
+    if (!AddPacked(*array, path)) {
+        ranges.emplace_back(array->begin(), array->end());
+    }
+
+    while (!ranges.empty()) {
+        auto& [next, end] = ranges.back();
+
+        if (next == end) {
+            ranges.pop_back();
+            continue;
+        }
+
+        const Item& element = *next++;
+
+        if (!element.IsArray()) {
+            AddKey(MakeIndexKey(element), path);
+        } else if (array = &std::get<ValueArray>(element.GetValue()); !AddPacked(*array, path)) {
+            ranges.emplace_back(array->begin(), array->end());
+        }
+    }
+}
+
+bool omfl::ValueIndex::AddPacked(const ValueArray& array, const std::string& path) {
+    // Packed arrays are read in place: iterating their Items would build and
+    // keep a copy of every element.
+    switch (array.PackedType()) {
+        case Type::Integer:
+            for (int32_t value: array.AsIntSpan()) {
+                AddKey(MakeIndexKey('i', &value, sizeof(value)), path);
+            }
+
+            return true;
+        case Type::Float:
+            for (double value: array.AsFloatSpan()) {
+                value += 0.0;
+                AddKey(MakeIndexKey('f', &value, sizeof(value)), path);
+            }
+
+            return true;
+        case Type::String:
+            for (std::string_view value: array.AsStringViews()) {
+                AddKey(MakeIndexKey('s', value.data(), value.size()), path);
+            }
+
+            return true;
+        default:
+            return false;
+    }
+}
+
+void omfl::ValueIndex::AddKey(std::string index_key, const std::string& path) {
+    auto& keys = keys_[std::move(index_key)];
+
+    // Repeated values inside one array map to the key only once.
+    if (keys.empty() || keys.back() != path) {
+        keys.push_back(path);
+    }
+}
+
+const std::vector<std::string>& omfl::ValueIndex::Find(const std::string& index_key) const {
+    static const std::vector<std::string> no_keys;
+
+    auto position = keys_.find(index_key);
+
+    if (position == keys_.end()) {
+        return no_keys;
+    }
+
+    return position->second;
+}
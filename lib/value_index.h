@@ -0,0 +1,33 @@
+#pragma once
+
+#include "parser.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace omfl {
+    // Maps every scalar value in a tree (array elements included) to the
+    // fully qualified keys holding it.
+    class ValueIndex {
+    public:
+        explicit ValueIndex(const Item& root);
+
+        const std::vector<std::string>& Find(int32_t value) const;
+        const std::vector<std::string>& Find(double value) const;
+        const std::vector<std::string>& Find(bool value) const;
+        const std::vector<std::string>& Find(std::string_view value) const;
+
+        size_t MemoryUsage() const;
+    private:
+        void AddSection(const Item& section, std::string& path);
+        void AddValue(const Item& item, const std::string& path);
+        // False for arrays stored as Items, see ValueArray::PackedType.
+        bool AddPacked(const ValueArray& array, const std::string& path);
+        void AddKey(std::string index_key, const std::string& path);
+        const std::vector<std::string>& Find(const std::string& index_key) const;
+
+        std::unordered_map<std::string, std::vector<std::string>> keys_;
+    };
+}
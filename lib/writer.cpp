@@ -0,0 +1,306 @@
+#include "writer.h"
+#include "grammar.h"
+
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+    // Formats a document into one buffer, handing it to the stream whenever it fills up.
+    class Writer {
+    public:
+        static constexpr size_t kFlushSize = 1 << 16;
+
+        Writer(std::string& buffer, std::ostream* stream)
+            : buffer_(buffer)
+            , stream_(stream)
+        {}
+
+        void WriteDocument(const omfl::Item& root) {
+            WriteValues(root);
+            WriteSubsections(root);
+            Flush();
+        }
+    private:
+        struct Range {
+            const omfl::Item* begin;
+            const omfl::Item* next;
+            const omfl::Item* end;
+        };
+
+        // Sections are walked with an explicit stack, as deep as the parser accepts them.
+        void WriteSubsections(const omfl::Item& root) {
+            std::string path;
+            // Each range remembers the length of its parent's path.
+            std::vector<std::pair<Range, size_t>> ranges = {{{root.begin(), root.begin(), root.end()}, 0}};
+
+            while (!ranges.empty()) {
+                auto& [range, path_size] = ranges.back();
+
+                if (range.next == range.end) {
+                    ranges.pop_back();
+                    continue;
+                }
+
+                const omfl::Item& child = *range.next++;
+
+                if (!child.IsSection()) {
+                    continue;
+                }
+
+                path.resize(path_size);
+
+                if (!path.empty()) {
+                    path += '.';
+                }
+
+                path += child.GetKey();
+
+                if (HasValues(child)) {
+                    buffer_ += "\n[";
+                    buffer_ += path;
+                    buffer_ += "]\n";
+
+                    WriteValues(child);
+                }
+
+                ranges.push_back({{child.begin(), child.begin(), child.end()}, path.size()});
+            }
+        }
+
+        void WriteValues(const omfl::Item& section) {
+            for (const auto& child: section) {
+                if (child.IsSection()) {
+                    continue;
+                }
+
+                buffer_ += child.GetKey();
+                buffer_ += " = ";
+                WriteValue(child);
+                buffer_ += '\n';
+
+                if (buffer_.size() >= kFlushSize) {
+                    Flush();
+                }
+            }
+        }
+
+    public:
+        void WriteValue(const omfl::Item& item) {
+            if (!item.IsArray()) {
+                WriteScalar(item);
+
+                return;
+            }
+
+            // Nested arrays are written with an explicit stack, as deep as the parser accepts them.
+            std::vector<Range> ranges;
+
+            OpenArray(item, ranges);
+
+            while (!ranges.empty()) {
+                Range& range = ranges.back();
+
+                if (range.next == range.end) {
+                    buffer_ += ']';
+                    ranges.pop_back();
+                    continue;
+                }
+
+                if (range.next != range.begin) {
+                    buffer_ += ", ";
+                }
+
+                const omfl::Item& element = *range.next++;
+
+                if (element.IsArray()) {
+                    OpenArray(element, ranges);
+                } else {
+                    WriteScalar(element);
+                }
+            }
+        }
+
+    private:
+        // Packed arrays are written whole from their spans, which unlike their
+        // Items do not have to be built first. Others are left open on ranges.
+        void OpenArray(const omfl::Item& item, std::vector<Range>& ranges) {
+            const auto& array = std::get<omfl::ValueArray>(item.GetValue());
+
+            buffer_ += '[';
+
+            switch (array.PackedType()) {
+                case omfl::Type::Integer:
+                    WritePacked(array.AsIntSpan(), [this](int32_t value) { WriteInt(value); });
+                    break;
+                case omfl::Type::Float:
+                    WritePacked(array.AsFloatSpan(), [this](double value) { WriteFloat(value); });
+                    break;
+                case omfl::Type::String:
+                    WritePacked(array.AsStringViews(), [this](std::string_view value) { WriteString(value); });
+                    break;
+                default:
+                    ranges.push_back({array.begin(), array.begin(), array.end()});
+                    return;
+            }
+
+            buffer_ += ']';
+        }
+
+        template <typename Values, typename Write>
+        void WritePacked(const Values& values, Write write) {
+            bool first = true;
+
+            for (const auto& value: values) {
+                if (!first) {
+                    buffer_ += ", ";
+                }
+
+                write(value);
+                first = false;
+            }
+        }
+
+        void WriteScalar(const omfl::Item& item) {
+            if (item.IsInt()) {
+                WriteInt(item.AsInt());
+            } else if (item.IsFloat()) {
+                WriteFloat(item.AsFloat());
+            } else if (item.IsString()) {
+                WriteString(item.AsString());
+            } else if (item.IsBool()) {
+                buffer_ += (item.AsBool() ? "true" : "false");
+            } else {
+                throw std::runtime_error("Undefined value cannot be written in OMFL.");
+            }
+        }
+
+        void WriteInt(int32_t value) {
+            char digits[16];
+            auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+
+            buffer_.append(digits, end);
+        }
+
+        void WriteString(std::string_view value) {
+            if (value.find_first_of("\"\n") != std::string_view::npos) {
+                throw std::runtime_error("String value cannot be written in OMFL.");
+            }
+
+            buffer_ += '"';
+            buffer_ += value;
+            buffer_ += '"';
+        }
+
+        void WriteFloat(double value) {
+            if (!std::isfinite(value)) {
+                throw std::runtime_error("Non-finite float cannot be written in OMFL.");
+            }
+
+            // Shortest round-tripping form, always in fixed notation since OMFL has no exponents.
+            char digits[512];
+            auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed);
+            std::string_view formatted(digits, end - digits);
+
+            buffer_ += formatted;
+
+            if (formatted.find('.') == std::string_view::npos) {
+                buffer_ += ".0";
+            }
+        }
+
+        static bool HasValues(const omfl::Item& section) {
+            for (const auto& child: section) {
+                if (!child.IsSection()) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void Flush() {
+            if (stream_ != nullptr) {
+                stream_->write(buffer_.data(), buffer_.size());
+                buffer_.clear();
+            }
+        }
+
+        std::string& buffer_;
+        std::ostream* stream_;
+    };
+}
+
+omfl::DocumentBuilder& omfl::DocumentBuilder::Section(std::string_view way) {
+    current_sections_.clear();
+
+    if (way.empty()) {
+        return *this;
+    }
+
+    size_t begin = 0;
+
+    while (true) {
+        size_t end = way.find('.', begin);
+        std::string_view section = way.substr(begin, end - begin);
+
+        if (!omfl::grammar::CheckKeyValidity(section)) {
+            throw std::runtime_error("Invalid section name: " + std::string(way));
+        }
+
+        current_sections_.emplace_back(section);
+
+        if (end == std::string_view::npos) {
+            break;
+        }
+
+        begin = end + 1;
+    }
+
+    return *this;
+}
+
+omfl::DocumentBuilder& omfl::DocumentBuilder::Set(std::string_view key, Value value) {
+    if (!omfl::grammar::CheckKeyValidity(key)) {
+        throw std::runtime_error("Invalid key: " + std::string(key));
+    }
+
+    Type type = static_cast<Type>(value.index());
+
+    if (type == Type::Undefined || type == Type::Section) {
+        throw std::runtime_error("Only plain values can be set.");
+    }
+
+    if (!parser_.Add(current_sections_, Item(key, std::move(value), type))) {
+        throw std::runtime_error("Key is already defined: " + std::string(key));
+    }
+
+    return *this;
+}
+
+const omfl::Parser& omfl::DocumentBuilder::Get() const {
+    return parser_;
+}
+
+omfl::Parser omfl::DocumentBuilder::Build() {
+    current_sections_.clear();
+
+    return std::move(parser_);
+}
+
+void omfl::Write(const Parser& parser, std::ostream& stream) {
+    std::string buffer;
+    buffer.reserve(Writer::kFlushSize);
+
+    Writer(buffer, &stream).WriteDocument(parser.GetRoot());
+}
+
+void omfl::WriteToBuffer(const Parser& parser, std::string& buffer) {
+    Writer(buffer, nullptr).WriteDocument(parser.GetRoot());
+}
+
+void omfl::WriteValue(const Item& item, std::string& buffer) {
+    Writer(buffer, nullptr).WriteValue(item);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "parser.h"
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace omfl {
+    // Builds a document in memory, section by section, with the same
+    // Item/section model that omfl::parse produces.
+    class DocumentBuilder {
+    public:
+        // Following Set calls go to the given dotted section, "" being the root.
+        DocumentBuilder& Section(std::string_view way);
+        DocumentBuilder& Set(std::string_view key, Value value);
+
+        const Parser& Get() const;
+        Parser Build();
+    private:
+        Parser parser_;
+        std::vector<std::string> current_sections_;
+    };
+
+    void Write(const Parser& parser, std::ostream& stream);
+
+    // Appends the document to buffer, which can be cleared and reused between calls.
+    void WriteToBuffer(const Parser& parser, std::string& buffer);
+
+    // Appends the value of an item as it is written after `=`.
+    void WriteValue(const Item& item, std::string& buffer);
+}
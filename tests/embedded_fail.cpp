@@ -0,0 +1,16 @@
+#include <lib/embedded.h>
+
+// Each case must stop the build: see the EmbeddedFailsToBuild tests.
+#if defined(EMBEDDED_INVALID_DOCUMENT)
+constexpr const auto& kConfig = omfl::Embed<"key = 1\nother = [1, 2">();
+#elif defined(EMBEDDED_MISSING_KEY)
+constexpr const auto& kConfig = omfl::Embed<"key = 1">();
+static_assert(kConfig.Get("other").AsInt() == 1);
+#elif defined(EMBEDDED_WRONG_TYPE)
+constexpr const auto& kConfig = omfl::Embed<"key = 1">();
+static_assert(kConfig.Get("key").AsString() == "1");
+#endif
+
+int main() {
+    return 0;
+}
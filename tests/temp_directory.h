@@ -0,0 +1,37 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+// Gives every test a fresh directory for the files it writes, named after
+// its suite and the process, and removes it afterwards.
+template <typename Base = testing::Test>
+class TempDirectoryTest : public Base {
+protected:
+    void SetUp() override {
+        std::string suite = testing::UnitTest::GetInstance()->current_test_info()->test_suite_name();
+        // Parameterized suites are prefixed with "Instantiation/".
+        std::replace(suite.begin(), suite.end(), '/', '_');
+
+        directory_ = std::filesystem::temp_directory_path() / ("omfl_" + suite + "_" + std::to_string(::getpid()));
+        std::filesystem::create_directories(directory_);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory_);
+    }
+
+    std::filesystem::path WriteFile(const std::string& name, const std::string& data) {
+        std::filesystem::path path = directory_ / name;
+        std::ofstream(path) << data;
+
+        return path;
+    }
+
+    std::filesystem::path directory_;
+};
@@ -0,0 +1,76 @@
+#include <lib/async.h>
+
+#include "temp_directory.h"
+
+#include <gtest/gtest.h>
+
+using namespace omfl;
+
+namespace {
+    // Counts how often coroutines were handed back to the executor.
+    class CountingExecutor : public LocalExecutor {
+    public:
+        void Post(std::coroutine_handle<> handle) override {
+            ++posts;
+            LocalExecutor::Post(handle);
+        }
+
+        size_t posts = 0;
+    };
+}
+
+class AsyncTestSuite : public TempDirectoryTest<testing::TestWithParam<bool>> {
+protected:
+    AsyncOptions Options(size_t yield_bytes = 64 * 1024) const {
+        return {.yield_bytes = yield_bytes, .use_io_uring = GetParam()};
+    }
+};
+
+TEST_P(AsyncTestSuite, ParseTest) {
+    auto path = WriteFile("config.omfl", R"(
+        version = 1
+        [server]
+        name = "main"
+        ports = [80, 443])");
+
+    LocalExecutor executor;
+    const auto root = executor.Run(ParseAsync(path, executor, {}, Options()));
+
+    ASSERT_TRUE(root.valid());
+    ASSERT_EQ(root, parse(path));
+    ASSERT_EQ(root.Get("server.ports")[1].AsInt(), 443);
+}
+
+TEST_P(AsyncTestSuite, YieldTest) {
+    std::string data;
+
+    for (int i = 0; i < 2000; ++i) {
+        data += "[section" + std::to_string(i) + "]\nkey = \"" + std::string(40, 'x') + "\"\n";
+    }
+
+    auto path = WriteFile("large.omfl", data);
+
+    CountingExecutor executor;
+    const auto root = executor.Run(ParseAsync(path, executor, {}, Options(1024)));
+
+    ASSERT_TRUE(root.valid());
+    ASSERT_EQ(root, parse(data));
+    ASSERT_GE(executor.posts, data.size() / 1024);
+}
+
+TEST_P(AsyncTestSuite, FailureTest) {
+    LocalExecutor executor;
+
+    ASSERT_THROW(executor.Run(ParseAsync(directory_ / "missing.omfl", executor, {}, Options())), std::runtime_error);
+
+    auto path = WriteFile("broken.omfl", "key = 1\nkey = 2");
+    ASSERT_FALSE(executor.Run(ParseAsync(path, executor, {}, Options())).valid());
+
+    path = WriteFile("big.omfl", "key = 1");
+    ASSERT_FALSE(executor.Run(ParseAsync(path, executor, {.limits = {.max_bytes = 4}}, Options())).valid());
+
+    path = WriteFile("empty.omfl", "");
+    ASSERT_TRUE(executor.Run(ParseAsync(path, executor, {}, Options())).valid());
+}
+
+INSTANTIATE_TEST_SUITE_P(IoBackends, AsyncTestSuite, testing::Values(true, false));
@@ -0,0 +1,122 @@
+#include <lib/omfl.h>
+
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+
+namespace {
+    std::string_view View(omfl_string value) {
+        return {value.data, value.size};
+    }
+
+    const omfl_item* Find(const omfl_item* section, std::string_view path) {
+        return omfl_find(section, path.data(), path.size());
+    }
+}
+
+TEST(CApiTestSuite, ParseTest) {
+    std::string data = R"(
+        title = "config"
+        [server]
+        port = 8080
+        ratio = 0.5
+        enabled = true
+        ports = [80, 443]
+        mixed = [1, "two"])";
+
+    omfl_document* document = nullptr;
+    ASSERT_EQ(omfl_parse_buffer(data.data(), data.size(), &document), OMFL_OK);
+
+    const omfl_item* root = omfl_root(document);
+    ASSERT_EQ(omfl_item_type(root), OMFL_SECTION);
+    ASSERT_EQ(omfl_size(root), 2);
+    ASSERT_EQ(View(omfl_item_key(omfl_at(root, 1))), "server");
+
+    int32_t port = 0;
+    ASSERT_TRUE(omfl_get_i32(Find(root, "server.port"), &port));
+    ASSERT_EQ(port, 8080);
+
+    double ratio = 0;
+    ASSERT_TRUE(omfl_get_f64(Find(root, "server.ratio"), &ratio));
+    ASSERT_EQ(ratio, 0.5);
+
+    int enabled = 0;
+    ASSERT_TRUE(omfl_get_bool(Find(root, "server.enabled"), &enabled));
+    ASSERT_EQ(enabled, 1);
+
+    omfl_string title;
+    ASSERT_TRUE(omfl_get_str(Find(root, "title"), &title));
+    ASSERT_EQ(View(title), "config");
+    ASSERT_FALSE(omfl_get_i32(Find(root, "title"), &port));
+
+    const int32_t* ports = nullptr;
+    size_t size = 0;
+    const omfl_item* array = Find(root, "server.ports");
+    ASSERT_TRUE(omfl_get_i32_array(array, &ports, &size));
+    ASSERT_EQ(size, 2);
+    ASSERT_EQ(ports[1], 443);
+    ASSERT_TRUE(omfl_get_i32(omfl_at(array, 0), &port));
+    ASSERT_EQ(port, 80);
+    ASSERT_EQ(omfl_at(array, 2), nullptr);
+
+    const omfl_item* mixed = Find(root, "server.mixed");
+    ASSERT_FALSE(omfl_get_i32_array(mixed, &ports, &size));
+    ASSERT_TRUE(omfl_get_str(omfl_at(mixed, 1), &title));
+    ASSERT_EQ(View(title), "two");
+
+    ASSERT_EQ(Find(root, "server.missing"), nullptr);
+    ASSERT_EQ(Find(root, "title.nested"), nullptr);
+    ASSERT_EQ(Find(root, ""), nullptr);
+
+    omfl_free(document);
+}
+
+TEST(CApiTestSuite, FailureTest) {
+    omfl_document* document = reinterpret_cast<omfl_document*>(1);
+    std::string_view data = "key = ";
+
+    ASSERT_EQ(omfl_parse_buffer(data.data(), data.size(), &document), OMFL_INVALID);
+    ASSERT_EQ(document, nullptr);
+
+    ASSERT_EQ(omfl_parse_file("/nonexistent/config.omfl", &document), OMFL_IO_ERROR);
+    ASSERT_EQ(document, nullptr);
+
+    ASSERT_EQ(omfl_abi_version(), OMFL_ABI_VERSION);
+}
+
+TEST(CApiTestSuite, MissingItemTest) {
+    std::string data = "[server]\nport = 8080\nports = [80, 443]";
+
+    omfl_document* document = nullptr;
+    ASSERT_EQ(omfl_parse_buffer(data.data(), data.size(), &document), OMFL_OK);
+
+    // Misses chain through the lookups and getters instead of crashing.
+    const omfl_item* missing = Find(omfl_root(document), "server.missing");
+    int32_t port = 7;
+    double ratio = 0;
+    int enabled = 0;
+    omfl_string name = {"x", 1};
+    const int32_t* ports = nullptr;
+    const double* ratios = nullptr;
+    size_t size = 5;
+
+    ASSERT_EQ(missing, nullptr);
+    ASSERT_FALSE(omfl_get_i32(missing, &port));
+    ASSERT_EQ(port, 7);
+    ASSERT_FALSE(omfl_get_f64(missing, &ratio));
+    ASSERT_FALSE(omfl_get_bool(missing, &enabled));
+    ASSERT_FALSE(omfl_get_str(missing, &name));
+    ASSERT_FALSE(omfl_get_i32_array(missing, &ports, &size));
+    ASSERT_FALSE(omfl_get_f64_array(missing, &ratios, &size));
+    ASSERT_EQ(size, 5);
+
+    ASSERT_EQ(omfl_item_type(missing), OMFL_UNDEFINED);
+    ASSERT_EQ(View(omfl_item_key(missing)), "");
+    ASSERT_EQ(omfl_size(missing), 0);
+    ASSERT_EQ(omfl_at(missing, 0), nullptr);
+    ASSERT_EQ(Find(missing, "port"), nullptr);
+    ASSERT_FALSE(omfl_get_i32(Find(Find(omfl_root(document), "client"), "port"), &port));
+    ASSERT_FALSE(omfl_get_i32(omfl_at(Find(omfl_root(document), "server.ports"), 2), &port));
+
+    omfl_free(document);
+}
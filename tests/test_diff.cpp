@@ -0,0 +1,123 @@
+#include <lib/diff.h>
+#include <lib/layered.h>
+#include <lib/parser.h>
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+    std::vector<std::string> Sorted(std::vector<std::string> keys) {
+        std::sort(keys.begin(), keys.end());
+
+        return keys;
+    }
+}
+
+TEST(DiffTestSuite, HashTest) {
+    const auto first = omfl::parse(std::string(R"(
+        a = 1
+        [b.c]
+        d = [1, "x", [2.5]]
+        e = -0.0)"));
+    const auto reordered = omfl::parse(std::string(R"(
+        [b.c]
+        e = 0.0
+        d = [1, "x", [2.5]]
+        [b]
+        f = true)"));
+    const auto other = omfl::parse(std::string(R"(
+        a = 1
+        [b.c]
+        d = [1, "x", [2.5]]
+        e = 0.0
+        [b]
+        f = true)"));
+
+    ASSERT_EQ(first.Get("b.c.d").Hash(), reordered.Get("b.c.d").Hash());
+    ASSERT_EQ(first.Get("b.c").Hash(), reordered.Get("b.c").Hash());
+    ASSERT_NE(first.Get("b").Hash(), reordered.Get("b").Hash());
+    ASSERT_EQ(reordered.Get("b").Hash(), other.Get("b").Hash());
+    ASSERT_NE(first.Get("a").Hash(), first.Get("b.c.d").Hash());
+
+    ASSERT_NE(omfl::parse(std::string("a = [1, 2]")).GetRoot().Hash(), omfl::parse(std::string("a = [2, 1]")).GetRoot().Hash());
+    ASSERT_NE(omfl::parse(std::string("a = 1")).GetRoot().Hash(), omfl::parse(std::string("b = 1")).GetRoot().Hash());
+    ASSERT_NE(omfl::parse(std::string("a = 1")).GetRoot().Hash(), omfl::parse(std::string("a = \"1\"")).GetRoot().Hash());
+}
+
+TEST(DiffTestSuite, DiffTest) {
+    const auto before = omfl::parse(std::string(R"(
+        version = 1
+        [server]
+        host = "localhost"
+        port = 8080
+        [server.tls]
+        enabled = false
+        [limits]
+        rps = 100
+        [cache]
+        size = 10)"));
+    const auto after = omfl::parse(std::string(R"(
+        version = 2
+        [server]
+        host = "localhost"
+        port = 8080
+        [server.tls]
+        enabled = true
+        cert = "a.pem"
+        [limits.rps]
+        burst = 10
+        steady = 5
+        [logging]
+        level = "info")"));
+
+    omfl::DocumentDiff diff = omfl::Diff(before, after);
+
+    ASSERT_EQ(Sorted(diff.added), (std::vector<std::string>{"limits.rps.burst", "limits.rps.steady", "logging.level", "server.tls.cert"}));
+    ASSERT_EQ(Sorted(diff.removed), (std::vector<std::string>{"cache.size", "limits.rps"}));
+    ASSERT_EQ(Sorted(diff.changed), (std::vector<std::string>{"server.tls.enabled", "version"}));
+
+    ASSERT_TRUE(omfl::Diff(after, after).Empty());
+    ASSERT_TRUE(omfl::Diff(before, omfl::parse(std::string("[cache]\nsize = 10\n[limits]\nrps = 100\n[server.tls]\nenabled = false\n[server]\nport = 8080\nhost = \"localhost\"\nversion = 1"))).changed.size() == 0);
+
+    omfl::DocumentDiff reverse = omfl::Diff(after, before);
+
+    ASSERT_EQ(Sorted(reverse.added), Sorted(diff.removed));
+    ASSERT_EQ(Sorted(reverse.removed), Sorted(diff.added));
+}
+
+TEST(DiffTestSuite, CostTest) {
+    std::string flat = "[flat]\n";
+    std::string nested;
+
+    for (int i = 0; i < 1000; ++i) {
+        flat += "key-" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+        nested += "[nested.part-" + std::to_string(i / 100) + "]\nkey-" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    }
+
+    // One changed key costs the width of every section on its path: the root and the section holding it.
+    auto flat_root = omfl::parse(flat);
+    auto flat_changed = flat_root;
+    flat_changed.Set("flat.key-500", 1);
+
+    omfl::DocumentDiff diff = omfl::Diff(flat_root, flat_changed);
+
+    ASSERT_EQ(diff.changed, (std::vector<std::string>{"flat.key-500"}));
+    ASSERT_EQ(diff.compared, 1 + 1000);
+
+    auto nested_root = omfl::parse(nested);
+    auto nested_changed = nested_root;
+    nested_changed.Set("nested.part-5.key-500", 1);
+
+    diff = omfl::Diff(nested_root, nested_changed);
+
+    ASSERT_EQ(diff.changed, (std::vector<std::string>{"nested.part-5.key-500"}));
+    ASSERT_EQ(diff.compared, 1 + 10 + 100);
+
+    // Removed keys are looked for only when some old key went unmatched.
+    flat_changed.Set("flat.key-1000", 1);
+
+    ASSERT_EQ(omfl::Diff(flat_changed, flat_root).compared, 1 + 1000 + 1001);
+    ASSERT_EQ(omfl::Diff(flat_root, flat_root).compared, 0);
+}
@@ -0,0 +1,170 @@
+#include <lib/document.h>
+#include <lib/parser.h>
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    const std::string kSource =
+        "title = \"Config\"   # shown on top\n"
+        "\n"
+        "# Servers go below.\n"
+        "[servers.first]\n"
+        "  port   =  8080\n"
+        "  debug = false# off in production\n"
+        "  hosts = [\"a\", \"b\"]\n"
+        "[servers.second]\n"
+        "port = 9090";
+
+    std::string Slice(const std::string& str, omfl::SourceSpan span) {
+        return str.substr(span.begin, span.end - span.begin);
+    }
+}
+
+TEST(DocumentTestSuite, SpansTest) {
+    std::vector<omfl::EntrySpans> spans;
+    const auto parser = omfl::ParseWithSpans(kSource, spans);
+
+    ASSERT_TRUE(parser.valid());
+    ASSERT_EQ(spans.size(), 5);
+
+    ASSERT_EQ(spans[0].path, "title");
+    ASSERT_EQ(Slice(kSource, spans[0].key), "title");
+    ASSERT_EQ(Slice(kSource, spans[0].value), "\"Config\"");
+    ASSERT_EQ(Slice(kSource, spans[0].comment), "# shown on top");
+
+    ASSERT_EQ(spans[1].path, "servers.first.port");
+    ASSERT_EQ(Slice(kSource, spans[1].key), "port");
+    ASSERT_EQ(Slice(kSource, spans[1].value), "8080");
+    ASSERT_EQ(spans[1].comment.begin, spans[1].value.end);
+    ASSERT_EQ(spans[1].comment.end, spans[1].value.end);
+
+    ASSERT_EQ(Slice(kSource, spans[2].value), "false");
+    ASSERT_EQ(Slice(kSource, spans[2].comment), "# off in production");
+    ASSERT_EQ(Slice(kSource, spans[3].value), "[\"a\", \"b\"]");
+
+    ASSERT_EQ(spans[4].path, "servers.second.port");
+    ASSERT_EQ(Slice(kSource, spans[4].value), "9090");
+}
+
+TEST(DocumentTestSuite, SetTest) {
+    omfl::EditableDocument document(kSource);
+
+    ASSERT_TRUE(document.valid());
+
+    document.Set("servers.first.port", int32_t(80));
+    document.Set("servers.first.debug", true);
+    document.Set("title", std::string("New title"));
+
+    ASSERT_EQ(document.EditCount(), 3);
+    ASSERT_EQ(document.GetParser().Get("servers.first.port").AsInt(), 80);
+    ASSERT_EQ(document.GetSource(), kSource);
+    ASSERT_EQ(document.Render(),
+        "title = \"New title\"   # shown on top\n"
+        "\n"
+        "# Servers go below.\n"
+        "[servers.first]\n"
+        "  port   =  80\n"
+        "  debug = true# off in production\n"
+        "  hosts = [\"a\", \"b\"]\n"
+        "[servers.second]\n"
+        "port = 9090");
+
+    // Setting a key again replaces the earlier edit.
+    document.Set("servers.first.port", int32_t(8000));
+
+    ASSERT_EQ(document.EditCount(), 3);
+    ASSERT_NE(document.Render().find("port   =  8000\n"), std::string::npos);
+}
+
+TEST(DocumentTestSuite, SetCommentTest) {
+    omfl::EditableDocument document(kSource);
+
+    document.SetComment("servers.first.port", "default");
+    document.SetComment("title", "");
+    document.SetComment("servers.first.debug", "on in tests");
+    document.SetComment("servers.second.port", "last");
+
+    ASSERT_EQ(document.Render(),
+        "title = \"Config\"\n"
+        "\n"
+        "# Servers go below.\n"
+        "[servers.first]\n"
+        "  port   =  8080  # default\n"
+        "  debug = false# on in tests\n"
+        "  hosts = [\"a\", \"b\"]\n"
+        "[servers.second]\n"
+        "port = 9090  # last");
+
+    // Setting a comment again replaces the earlier edit, clearing it drops the spaces before it too.
+    document.SetComment("servers.first.port", "");
+    document.SetComment("title", "shown on top");
+
+    ASSERT_EQ(document.EditCount(), 4);
+    ASSERT_EQ(document.Render().substr(0, document.Render().find("\n[servers.second]")),
+        "title = \"Config\"   # shown on top\n"
+        "\n"
+        "# Servers go below.\n"
+        "[servers.first]\n"
+        "  port   =  8080\n"
+        "  debug = false# on in tests\n"
+        "  hosts = [\"a\", \"b\"]");
+
+    ASSERT_THROW(document.SetComment("title", "two\nlines"), std::runtime_error);
+}
+
+TEST(DocumentTestSuite, RenderParsesBackTest) {
+    omfl::EditableDocument document(kSource);
+
+    omfl::ValueArray hosts;
+    hosts.Add(omfl::Value(std::in_place_type<std::string>, "c"), omfl::Type::String);
+
+    document.Set("servers.first.hosts", std::move(hosts));
+    document.Set("servers.second.port", 1.5);
+    document.SetComment("servers.second.port", "was 9090");
+
+    const auto reparsed = omfl::parse(document.Render());
+
+    ASSERT_TRUE(reparsed.valid());
+    ASSERT_EQ(reparsed.GetRoot().Hash(), document.GetParser().GetRoot().Hash());
+    ASSERT_EQ(reparsed.Get("servers.first.hosts")[0].AsString(), "c");
+    ASSERT_EQ(reparsed.Get("servers.second.port").AsFloat(), 1.5);
+}
+
+TEST(DocumentTestSuite, ErrorTest) {
+    omfl::EditableDocument document(kSource);
+
+    ASSERT_THROW(document.Set("servers.first.user", int32_t(1)), std::runtime_error);
+    ASSERT_THROW(document.Set("servers.first", int32_t(1)), std::runtime_error);
+    ASSERT_THROW(document.Set("title", omfl::Value()), std::runtime_error);
+    ASSERT_EQ(document.EditCount(), 0);
+    ASSERT_EQ(document.Render(), kSource);
+
+    omfl::EditableDocument invalid("key = = 1");
+
+    ASSERT_FALSE(invalid.valid());
+    ASSERT_THROW(invalid.Set("key", int32_t(1)), std::runtime_error);
+}
+
+TEST(DocumentTestSuite, CopyTest) {
+    auto original = std::make_unique<omfl::EditableDocument>(kSource);
+
+    original->Set("servers.first.port", int32_t(80));
+
+    omfl::EditableDocument copy = *original;
+    omfl::EditableDocument moved = std::move(*original);
+
+    original.reset();
+    copy.Set("servers.second.port", int32_t(90));
+
+    ASSERT_NE(copy.FindSpans("servers.second.port"), nullptr);
+    ASSERT_NE(moved.FindSpans("servers.second.port"), nullptr);
+    ASSERT_EQ(copy.EditCount(), 2);
+    ASSERT_EQ(moved.EditCount(), 1);
+    ASSERT_EQ(omfl::parse(copy.Render()).Get("servers.second.port").AsInt(), 90);
+    ASSERT_EQ(omfl::parse(moved.Render()).Get("servers.second.port").AsInt(), 9090);
+    ASSERT_EQ(omfl::parse(moved.Render()).Get("servers.first.port").AsInt(), 80);
+}
@@ -0,0 +1,148 @@
+#include <lib/embedded.h>
+#include <lib/parser.h>
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr const auto& kConfig = omfl::Embed<R"(
+        name = "server"  # comment
+
+        [network.http]
+        port = 8080
+        ratio = -0.25
+        enabled = true
+        hosts = ["a.example", "b, c", []]
+        limits = [[1, +2], [3.5]]
+
+        [network.tcp]
+        backlog = -2147483648)">();
+
+    static_assert(kConfig.Size() == 7);
+    static_assert(kConfig.Get("name").AsString() == "server");
+    static_assert(kConfig.Get("network.http.port").AsInt() == 8080);
+    static_assert(kConfig.Get("network.http.ratio").AsFloat() == -0.25);
+    static_assert(kConfig.Get("network.http.enabled").AsBool());
+    static_assert(kConfig.Get("network.http.hosts").Size() == 3);
+    static_assert(kConfig.Get("network.http.hosts")[1].AsString() == "b, c");
+    static_assert(kConfig.Get("network.http.hosts")[2].Size() == 0);
+    static_assert(kConfig.Get("network.http.limits")[0][1].AsInt() == 2);
+    static_assert(kConfig.Get("network.http.limits")[1][0].AsFloat() == 3.5);
+    static_assert(kConfig.Get("network.tcp.backlog").AsInt() == -2147483648);
+    static_assert(!kConfig.Find("network.http").has_value());
+    static_assert(!kConfig.Find("network.http.port.value").has_value());
+
+    bool SameValue(const omfl::Item& item, omfl::embedded::View view) {
+        if (item.GetType() != view.GetType()) {
+            return false;
+        }
+
+        switch (view.GetType()) {
+            case omfl::Type::Integer:
+                return item.AsInt() == view.AsInt();
+            case omfl::Type::Float:
+                return item.AsFloat() == view.AsFloat();
+            case omfl::Type::String:
+                return item.AsString() == view.AsString();
+            case omfl::Type::Boolean:
+                return item.AsBool() == view.AsBool();
+            default:
+                break;
+        }
+
+        if (item.Size() != view.Size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < view.Size(); ++i) {
+            if (!SameValue(item[i], view[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+TEST(EmbeddedTestSuite, LookupTest) {
+    std::optional<omfl::embedded::View> port = kConfig.Find(std::string("network.http.port"));
+
+    ASSERT_TRUE(port.has_value());
+    ASSERT_EQ(port->AsInt(), 8080);
+    ASSERT_THROW(port->AsString(), std::runtime_error);
+    ASSERT_THROW(kConfig.Find("network.http.hosts")->operator[](3), std::runtime_error);
+    ASSERT_FALSE(kConfig.Find("network.udp.port").has_value());
+}
+
+TEST(EmbeddedTestSuite, ErrorLineTest) {
+    omfl::embedded::Draft draft;
+
+    omfl::embedded::Parse("a = 1\n[b]\nc = 2\nd =\ne = 3", draft);
+
+    ASSERT_EQ(draft.error_line, 4);
+}
+
+// The compile-time parser runs at runtime too, where it has to agree with omfl::parse.
+TEST(EmbeddedTestSuite, SameAsRuntimeParserTest) {
+    std::vector<std::string> documents = {
+        "",
+        "key = 1",
+        "key = 99999999999",
+        "key = -2147483649",
+        "key = +0.5\nother = 007",
+        "key = 1.",
+        "key = .5",
+        "key = 1.5.5",
+        "key = \"a = b # c\" # comment",
+        "key = \"unterminated",
+        "key = tru",
+        "bad key = 1",
+        "key == 1",
+        "key = 1 = 2",
+        "= 1",
+        "key =",
+        "key = [1,,2]",
+        "key = [1, ,2]",
+        "key = [[1], 2]",
+        "key = [[1] 2]",
+        "key = [1, [2, [3, [\"]\"]]]]",
+        "key = [1]]",
+        "key = [1] [2]",
+        "[section\nkey = 1",
+        "[section] key = 1",
+        "[section] # comment\nkey = 1",
+        "[a..b]\nkey = 1",
+        "[]\nkey = 1",
+        "# comment [a]\nkey = 1\nother = 2",
+        "a = 1\n[a]\nb = 2",
+        "[a.b]\nc = 1\n[a]\nb = 2",
+        "[a]\nb = 1\n[a]\nc = 2",
+        "[a]\nb = 1\n[a]\nb = 2",
+        "key = 1\nkey = 2",
+        "abc[x]\nkey = 1",
+        "  [ x ]\nkey = 1",
+        "key = 1\n\n\n[x]\n\n  other = \"\"  \n",
+    };
+
+    for (const auto& document: documents) {
+        SCOPED_TRACE(document);
+
+        omfl::embedded::Draft draft;
+        omfl::Parser parser = omfl::parse(document);
+
+        omfl::embedded::Parse(document, draft);
+
+        ASSERT_EQ(draft.error_line == 0, parser.valid());
+
+        if (!parser.valid()) {
+            continue;
+        }
+
+        for (size_t i = 0; i < draft.entries.size(); ++i) {
+            omfl::embedded::View view(document, draft.nodes.data(), &draft.entries[i].value);
+
+            ASSERT_TRUE(SameValue(parser.Get(draft.paths[i]), view)) << draft.paths[i];
+        }
+    }
+}
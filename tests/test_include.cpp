@@ -0,0 +1,153 @@
+#include <lib/parser.h>
+
+#include "temp_directory.h"
+
+#include <gtest/gtest.h>
+
+using namespace omfl;
+
+class IncludeTestSuite : public TempDirectoryTest<> {
+protected:
+    ParseOptions options_{.allow_includes = true};
+};
+
+TEST_F(IncludeTestSuite, IncludeTest) {
+    WriteFile("common.omfl", "name = \"shared\"\n[limits]\nmax = 10");
+
+    auto path = WriteFile("main.omfl", R"(
+        version = 1
+        [service]
+        @include "common.omfl"  # shared fragment
+        port = 80)");
+
+    const auto root = parse(path, options_);
+    ASSERT_TRUE(root.valid());
+
+    ASSERT_EQ(root.Get("version").AsInt(), 1);
+    ASSERT_EQ(root.Get("service.name").AsString(), "shared");
+    ASSERT_EQ(root.Get("service.limits.max").AsInt(), 10);
+    ASSERT_EQ(root.Get("service.port").AsInt(), 80);
+}
+
+TEST_F(IncludeTestSuite, DisabledTest) {
+    WriteFile("common.omfl", "name = \"shared\"");
+    auto path = WriteFile("main.omfl", "@include \"common.omfl\"");
+
+    ASSERT_FALSE(parse(path).valid());
+    ASSERT_TRUE(parse(path, options_).valid());
+}
+
+TEST_F(IncludeTestSuite, CacheTest) {
+    auto fragment = WriteFile("fragment.omfl", "value = 1");
+    auto first = WriteFile("first.omfl", "[a]\n@include \"fragment.omfl\"");
+    auto second = WriteFile("second.omfl", "[b]\n@include \"fragment.omfl\"");
+
+    ASSERT_EQ(parse(first, options_).Get("a.value").AsInt(), 1);
+
+    // Same modification time: the cached fragment is reused without rereading.
+    auto modification_time = std::filesystem::last_write_time(fragment);
+    WriteFile("fragment.omfl", "value = 2");
+    std::filesystem::last_write_time(fragment, modification_time);
+
+    ASSERT_EQ(parse(second, options_).Get("b.value").AsInt(), 1);
+
+    std::filesystem::last_write_time(fragment, modification_time + std::chrono::seconds(1));
+
+    ASSERT_EQ(parse(second, options_).Get("b.value").AsInt(), 2);
+}
+
+TEST_F(IncludeTestSuite, CycleTest) {
+    WriteFile("a.omfl", "a = 1\n@include \"b.omfl\"");
+    WriteFile("b.omfl", "b = 1\n@include \"a.omfl\"");
+
+    ASSERT_FALSE(parse(directory_ / "a.omfl", options_).valid());
+
+    // A fragment cached on its own must still be caught closing a cycle.
+    WriteFile("c.omfl", "c = 1\n@include \"d.omfl\"");
+    WriteFile("d.omfl", "d = 1");
+    ASSERT_TRUE(parse(directory_ / "c.omfl", options_).valid());
+
+    WriteFile("d.omfl", "d = 2\n@include \"c.omfl\"");
+    std::filesystem::last_write_time(directory_ / "d.omfl", std::filesystem::last_write_time(directory_ / "d.omfl") + std::chrono::seconds(1));
+    ASSERT_FALSE(parse(directory_ / "d.omfl", options_).valid());
+
+    auto self = WriteFile("self.omfl", "@include \"self.omfl\"");
+    ASSERT_FALSE(parse(self, options_).valid());
+}
+
+TEST_F(IncludeTestSuite, DepthTest) {
+    for (int i = 0; i < 5; ++i) {
+        WriteFile("level" + std::to_string(i) + ".omfl", "[l" + std::to_string(i) + "]\n@include \"level" + std::to_string(i + 1) + ".omfl\"");
+    }
+
+    WriteFile("level5.omfl", "leaf = true");
+
+    ASSERT_TRUE(parse(directory_ / "level0.omfl", options_).Get("l0.l1.l2.l3.l4.leaf").AsBool());
+
+    ParseOptions shallow = options_;
+    shallow.max_include_depth = 3;
+
+    ASSERT_FALSE(parse(directory_ / "level0.omfl", shallow).valid());
+}
+
+TEST_F(IncludeTestSuite, DeepFragmentTest) {
+    std::string path = "a";
+
+    for (int i = 0; i < 100000; ++i) {
+        path += ".a";
+    }
+
+    // Included sections are spliced without recursion, however deep they go.
+    WriteFile("deep.omfl", "[" + path + "]\nleaf = true");
+
+    const auto root = parse(WriteFile("main.omfl", "[service]\n@include \"deep.omfl\""), options_);
+
+    ASSERT_TRUE(root.valid());
+    ASSERT_TRUE(root.Get("service." + path + ".leaf").AsBool());
+}
+
+TEST_F(IncludeTestSuite, ConflictTest) {
+    WriteFile("fragment.omfl", "key = 1");
+    auto path = WriteFile("main.omfl", "key = 2\n@include \"fragment.omfl\"");
+
+    ASSERT_FALSE(parse(path, options_).valid());
+    ASSERT_FALSE(parse(WriteFile("missing.omfl", "@include \"nowhere.omfl\""), options_).valid());
+    ASSERT_FALSE(parse(WriteFile("garbage.omfl", "@include nowhere.omfl"), options_).valid());
+}
+
+TEST_F(IncludeTestSuite, LimitsTest) {
+    WriteFile("values.omfl", "a = 1\nb = 2\nc = 3");
+    auto path = WriteFile("limited.omfl", "x = 0\n@include \"values.omfl\"");
+
+    ParseOptions options = options_;
+
+    options.limits.max_keys = 4;
+    ASSERT_TRUE(parse(path, options).valid());
+
+    options.limits.max_keys = 3;
+    ASSERT_FALSE(parse(path, options).valid());
+
+    options.limits = {.max_bytes = 10};
+    ASSERT_FALSE(parse(path, options).valid());
+}
+
+TEST_F(IncludeTestSuite, CachedLimitsTest) {
+    WriteFile("wide.omfl", "ports = [1, 2, 3, 4]\n[deep.deeper]\nkey = 1");
+    auto path = WriteFile("strict.omfl", "@include \"wide.omfl\"");
+
+    // A fragment cached by a lenient parse is checked again under stricter limits.
+    ASSERT_TRUE(parse(path, options_).valid());
+
+    ParseOptions options = options_;
+
+    options.limits.max_array_length = 2;
+    ASSERT_FALSE(parse(path, options).valid());
+
+    options.limits = {.max_depth = 1};
+    ASSERT_FALSE(parse(path, options).valid());
+
+    options.limits = {.max_bytes = 16};
+    ASSERT_FALSE(parse(path, options).valid());
+
+    ASSERT_TRUE(parse(path, options_).valid());
+}
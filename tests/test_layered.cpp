@@ -0,0 +1,74 @@
+#include <lib/layered.h>
+
+#include "temp_directory.h"
+
+#include <gtest/gtest.h>
+
+using namespace omfl;
+
+class LayeredTestSuite : public TempDirectoryTest<> {};
+
+TEST_F(LayeredTestSuite, OverrideTest) {
+    auto base = WriteFile("base.omfl", R"(
+        [common]
+        name = "base"
+        version = 1
+
+        [servers.first]
+        ip = "127.0.0.1"
+        ports = [1, 2]
+        [servers.second]
+        ip = "127.0.0.2")");
+
+    auto region = WriteFile("region.omfl", R"(
+        [common]
+        version = 2
+
+        [servers.first]
+        ports = [3])");
+
+    auto host = WriteFile("host.omfl", R"(
+        servers = "disabled"
+        [common]
+        host = "alpha")");
+
+    const auto config = LayeredConfig::Load({base, region, host});
+    ASSERT_TRUE(config.valid());
+
+    ASSERT_EQ(config.Get("common.name").AsString(), "base");
+    ASSERT_EQ(config.Get("common.version").AsInt(), 2);
+    ASSERT_EQ(config.Get("common.host").AsString(), "alpha");
+    ASSERT_EQ(config.Get("servers").AsString(), "disabled");
+
+    ASSERT_EQ(config.GetProvenance("common.name"), base);
+    ASSERT_EQ(config.GetProvenance("common.version"), region);
+    ASSERT_EQ(config.GetProvenance("common"), host);
+    ASSERT_EQ(config.GetProvenance("servers"), host);
+    ASSERT_THROW(config.GetProvenance("servers.first.ports"), std::runtime_error);
+}
+
+TEST_F(LayeredTestSuite, SectionMergeTest) {
+    auto base = WriteFile("base.omfl", "[a]\nx = 1\ny = [1, 2]");
+    auto top = WriteFile("top.omfl", "[a]\ny = [3]\n[a.b]\nz = true");
+
+    const auto config = LayeredConfig::Load({base, top});
+    ASSERT_TRUE(config.valid());
+
+    ASSERT_EQ(config.Get("a.x").AsInt(), 1);
+    ASSERT_EQ(config.Get("a.y").Size(), 1);
+    ASSERT_EQ(config.Get("a.y")[0].AsInt(), 3);
+    ASSERT_TRUE(config.Get("a.b.z").AsBool());
+    ASSERT_EQ(config.GetProvenance("a.x"), base);
+    ASSERT_EQ(config.GetProvenance("a.b.z"), top);
+
+    const auto expected = parse(std::string("[a]\nx = 1\ny = [3]\n[a.b]\nz = true"));
+
+    ASSERT_EQ(config.GetMerged().GetRoot().Hash(), expected.GetRoot().Hash());
+}
+
+TEST_F(LayeredTestSuite, InvalidLayerTest) {
+    auto base = WriteFile("base.omfl", "key = 1");
+    auto broken = WriteFile("broken.omfl", "key = ");
+
+    ASSERT_FALSE(LayeredConfig::Load({base, broken}).valid());
+}
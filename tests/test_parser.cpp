@@ -1,6 +1,8 @@
+#include <lib/grammar.h>
 #include <lib/parser.h>
 
 #include <gtest/gtest.h>
+#include <pthread.h>
 #include <sstream>
 
 using namespace omfl;
@@ -143,6 +145,15 @@ TEST(ParserTestSuite, ArrayTest) {
     ASSERT_EQ(root.Get("key1")[2].AsInt(), 3);
 
     ASSERT_EQ(root.Get("key1")[100500].AsIntOrDefault(99), 99);
+
+    const auto strings = parse(std::string(R"(key = ["a, b", "[c]"])"));
+    ASSERT_TRUE(strings.valid());
+    ASSERT_EQ(strings.Get("key")[0].AsString(), "a, b");
+    ASSERT_EQ(strings.Get("key")[1].AsString(), "[c]");
+
+    ASSERT_FALSE(parse(std::string("key = [1] 2")).valid());
+    ASSERT_FALSE(parse(std::string("key = [[1] 2]")).valid());
+    ASSERT_FALSE(parse(std::string("key = [1 [2]]")).valid());
 }
 
 TEST(ParserTestSuite, DiffTypesArrayTest) {
@@ -178,6 +189,75 @@ TEST(ParserTestSuite, DiffTypesArrayTest) {
     ASSERT_EQ(root.Get("key1")[5][2].AsInt(), 28);
 }
 
+TEST(ParserTestSuite, HomogeneousArrayTest) {
+    std::string data = R"(
+        ints = [10005, 1006, -3, 4, 5]
+        floats = [1.5, -2.25, 3.0]
+        strings = ["127.0.0.1", "", "localhost"]
+        mixed = [1, 2, "three", 4.0])";
+
+    const auto root = parse(data);
+
+    ASSERT_TRUE(root.valid());
+
+    ASSERT_EQ(root.Get("ints")[0].AsInt(), 10005);
+    ASSERT_EQ(root.Get("ints")[4].AsInt(), 5);
+    ASSERT_FLOAT_EQ(root.Get("floats")[1].AsFloat(), -2.25);
+    ASSERT_EQ(root.Get("strings")[0].AsString(), "127.0.0.1");
+    ASSERT_EQ(root.Get("strings")[1].AsString(), "");
+    ASSERT_EQ(root.Get("strings")[2].AsString(), "localhost");
+
+    ASSERT_EQ(root.Get("mixed")[1].AsInt(), 2);
+    ASSERT_EQ(root.Get("mixed")[2].AsString(), "three");
+    ASSERT_FLOAT_EQ(root.Get("mixed")[3].AsFloat(), 4.0);
+
+    const Item& first = root.Get("ints")[0];
+    ASSERT_EQ(&first, &root.Get("ints")[0]);
+    ASSERT_FALSE(root.Get("ints")[5].IsInt());
+}
+
+TEST(ParserTestSuite, ArrayBulkAccessTest) {
+    std::string data = R"(
+        ports = [10005, 1006, 7]
+        weights = [0.5, 0.25]
+        hosts = ["alpha", "beta"]
+        empty = []
+        mixed = [1, "two"])";
+
+    const auto root = parse(data);
+
+    ASSERT_TRUE(root.valid());
+
+    ASSERT_EQ(root.Get("ports").Size(), 3);
+    ASSERT_EQ(root.Get("empty").Size(), 0);
+    ASSERT_EQ(root.Get("mixed").Size(), 2);
+
+    std::vector<int32_t> ports;
+
+    for (const Item& port: root.Get("ports")) {
+        ports.push_back(port.AsInt());
+    }
+
+    ASSERT_EQ(ports, (std::vector<int32_t>{10005, 1006, 7}));
+
+    auto port_span = root.Get("ports").AsIntSpan();
+    ASSERT_EQ(std::vector<int32_t>(port_span.begin(), port_span.end()), ports);
+
+    auto weights = root.Get("weights").AsFloatSpan();
+    ASSERT_EQ(weights.size(), 2);
+    ASSERT_FLOAT_EQ(weights[1], 0.25);
+
+    auto hosts = root.Get("hosts").AsStringViews();
+    ASSERT_EQ(hosts.Size(), 2);
+    ASSERT_EQ(hosts[0], "alpha");
+    ASSERT_EQ(hosts[1], "beta");
+    ASSERT_EQ(std::vector<std::string_view>(hosts.begin(), hosts.end()), (std::vector<std::string_view>{"alpha", "beta"}));
+
+    ASSERT_TRUE(root.Get("empty").AsIntSpan().empty());
+    ASSERT_THROW(root.Get("mixed").AsIntSpan(), std::runtime_error);
+    ASSERT_THROW(root.Get("hosts").AsIntSpan(), std::runtime_error);
+}
+
 TEST(ParserTestSuite, CommentsTest) {
     std::string data = R"(
         key1 = 100500  # some important value
@@ -236,3 +316,579 @@ TEST(ParserTestSuite, GetSectionTest) {
 
     ASSERT_EQ(root.Get("level1").Get("level2").Get("level3").Get("key1").AsInt(), 1);
 }
+
+TEST(ParserTestSuite, MalformedInputTest) {
+    ASSERT_FALSE(parse(std::string("key = 99999999999")).valid());
+    ASSERT_FALSE(parse(std::string("key = -2147483649")).valid());
+    ASSERT_TRUE(parse(std::string("key = -2147483648")).valid());
+    ASSERT_FALSE(parse(std::string("[section\nkey = 1")).valid());
+    ASSERT_FALSE(parse(std::string("[section] key = 1")).valid());
+    ASSERT_TRUE(parse(std::string("[section] # comment\nkey = 1")).valid());
+    ASSERT_FALSE(parse(std::string("a = 1\n[a]\nb = 2")).valid());
+
+    const auto root = parse(std::string("[a]\nb = 1"));
+    ASSERT_TRUE(root.valid());
+    ASSERT_THROW(root.Get("a.c"), std::runtime_error);
+    ASSERT_THROW(root.Get("a.b.c"), std::runtime_error);
+}
+
+TEST(ParserTestSuite, LimitsTest) {
+    std::string data = R"(
+        [a.b]
+        key = [1, [2, 3], []]
+        other = "value")";
+
+    ASSERT_TRUE(parse(data, {.limits = {.max_depth = 4, .max_array_length = 3, .max_keys = 2}}).valid());
+
+    ASSERT_FALSE(parse(data, {.limits = {.max_bytes = 16}}).valid());
+    ASSERT_FALSE(parse(data, {.limits = {.max_depth = 1}}).valid());
+    ASSERT_FALSE(parse(data, {.limits = {.max_depth = 3}}).valid());
+    ASSERT_FALSE(parse(data, {.limits = {.max_array_length = 2}}).valid());
+    ASSERT_FALSE(parse(data, {.limits = {.max_keys = 1}}).valid());
+    ASSERT_FALSE(parse(data, {.limits = {.max_memory = 64}}).valid());
+
+    std::string nested = "key = " + std::string(100000, '[') + std::string(100000, ']');
+    ASSERT_FALSE(parse(nested, {.limits = {.max_depth = 64}}).valid());
+
+    // Brackets and commas inside strings do not count.
+    ASSERT_TRUE(parse(std::string(R"(k = ["[[[[", "]]]]"])"), {.limits = {.max_depth = 3}}).valid());
+    ASSERT_TRUE(parse(std::string(R"(k = ["a,b,c"])"), {.limits = {.max_array_length = 2}}).valid());
+    ASSERT_FALSE(parse(std::string(R"(k = ["a", "b,c", "d"])"), {.limits = {.max_array_length = 2}}).valid());
+}
+
+TEST(ParserTestSuite, DeepNestingTest) {
+    // Parsing, lookup and destruction must not recurse per nesting level,
+    // so they are run on a 64 KB stack.
+    struct Result {
+        bool valid = false;
+        size_t array_depth = 0;
+        int32_t innermost = 0;
+        int32_t section_value = 0;
+    } result;
+
+    auto run = [](void* argument) -> void* {
+        constexpr size_t kDepth = 100000;
+        auto& result = *static_cast<Result*>(argument);
+
+        std::string way(2 * kDepth - 1, '.');
+
+        for (size_t i = 0; i < way.size(); i += 2) {
+            way[i] = 's';
+        }
+
+        std::string data = "key = " + std::string(kDepth, '[') + "7" + std::string(kDepth, ']') + "\n[" + way + "]\nvalue = 3";
+        const auto root = parse(data);
+
+        result.valid = root.valid();
+
+        if (result.valid) {
+            const Item* item = &root.Get("key");
+
+            for (; item->IsArray(); item = &(*item)[0]) {
+                ++result.array_depth;
+            }
+
+            result.innermost = item->AsIntOrDefault(0);
+            result.section_value = root.Get(way + ".value").AsIntOrDefault(0);
+        }
+
+        return nullptr;
+    };
+
+    pthread_attr_t attributes;
+    pthread_t thread;
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, 64 * 1024);
+    ASSERT_EQ(pthread_create(&thread, &attributes, run, &result), 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attributes);
+
+    ASSERT_TRUE(result.valid);
+    ASSERT_EQ(result.array_depth, 100000);
+    ASSERT_EQ(result.innermost, 7);
+    ASSERT_EQ(result.section_value, 3);
+}
+
+TEST(ParserTestSuite, FindTest) {
+    std::string data = R"(
+        name = "root"
+        [a.b]
+        port = 8080
+        ratio = 0.5
+        enabled = true)";
+
+    const auto root = parse(data);
+    ASSERT_TRUE(root.valid());
+
+    ASSERT_EQ(root.Find("a.b.port"), &root.Get("a.b.port"));
+    ASSERT_EQ(root.Find("a.b.missing"), nullptr);
+    ASSERT_EQ(root.Find("name.nested"), nullptr);
+    ASSERT_EQ(root.Find("a..b"), nullptr);
+    ASSERT_EQ(root.Find(""), nullptr);
+    ASSERT_EQ(root.Get("a").Find("b.ratio")->AsFloat(), 0.5);
+
+    ASSERT_EQ(root.GetIntOr("a.b.port", 5), 8080);
+    ASSERT_EQ(root.GetIntOr("a.b.ratio", 5), 5);
+    ASSERT_EQ(root.GetIntOr("a.c.port", 5), 5);
+    ASSERT_EQ(root.GetFloatOr("a.b.ratio", 1.5), 0.5);
+    ASSERT_EQ(root.GetStringOr("name", "default"), "root");
+    ASSERT_EQ(root.GetStringOr("a.b", "default"), "default");
+    ASSERT_EQ(root.GetBoolOr("a.b.enabled", false), true);
+    ASSERT_EQ(root.Get("a.b").GetIntOr("port", 0), 8080);
+}
+
+TEST(ParserTestSuite, SectionIterationTest) {
+    std::string data = R"(
+        [servers.first]
+        enabled = true
+        ip = "127.0.0.1"
+
+        [servers.second]
+        enabled = false
+
+        [common]
+        version = 1)";
+
+    const auto root = parse(data);
+    ASSERT_TRUE(root.valid());
+
+    std::vector<std::string> servers;
+
+    for (const Item& server: root.Get("servers")) {
+        servers.push_back(server.GetKey());
+    }
+
+    ASSERT_EQ(servers, (std::vector<std::string>{"first", "second"}));
+    ASSERT_EQ(root.Get("servers.first").Size(), 2);
+
+    std::vector<std::pair<std::string, size_t>> visited;
+
+    root.Visit([&visited](const Item& item, size_t depth) {
+        visited.emplace_back(item.GetKey(), depth);
+    });
+
+    ASSERT_EQ(visited, (std::vector<std::pair<std::string, size_t>>{
+        {"servers", 0},
+        {"first", 1},
+        {"enabled", 2},
+        {"ip", 2},
+        {"second", 1},
+        {"enabled", 2},
+        {"common", 0},
+        {"version", 1}
+    }));
+}
+
+TEST(ParserTestSuite, ValueTypeTest) {
+    using grammar::GetValueType;
+
+    ASSERT_EQ(GetValueType("  -12  "), Type::Integer);
+    ASSERT_EQ(GetValueType("+0.5"), Type::Float);
+    ASSERT_EQ(GetValueType("\"a [b] # c\" "), Type::String);
+    ASSERT_EQ(GetValueType("false"), Type::Boolean);
+    ASSERT_EQ(GetValueType("[1, [2]] [3]"), Type::Array);
+
+    ASSERT_EQ(GetValueType(""), Type::Undefined);
+    ASSERT_EQ(GetValueType("1 2"), Type::Undefined);
+    ASSERT_EQ(GetValueType("-.5"), Type::Undefined);
+    ASSERT_EQ(GetValueType("5."), Type::Undefined);
+    ASSERT_EQ(GetValueType("1-"), Type::Undefined);
+    ASSERT_EQ(GetValueType("tru"), Type::Undefined);
+    ASSERT_EQ(GetValueType("truee"), Type::Undefined);
+    ASSERT_EQ(GetValueType("\"a\" \""), Type::Undefined);
+    ASSERT_EQ(GetValueType("[1]]"), Type::Undefined);
+    ASSERT_EQ(GetValueType("[[1]"), Type::Undefined);
+    ASSERT_EQ(GetValueType("[1] x"), Type::Undefined);
+
+    ASSERT_TRUE(grammar::CheckKeyValidity("key_1-A"));
+    ASSERT_FALSE(grammar::CheckKeyValidity("key 1"));
+    ASSERT_FALSE(grammar::CheckKeyValidity("\xE9"));
+}
+
+TEST(ParserTestSuite, QueryTest) {
+    std::string data = R"(
+        [servers.first]
+        enabled = true
+        ports = [1, 2]
+
+        [servers.second]
+        enabled = false
+
+        [servers.second.backup]
+        enabled = true
+        ports = [3]
+
+        [common]
+        ports = [4])";
+
+    const auto root = parse(data);
+    ASSERT_TRUE(root.valid());
+
+    auto enabled = root.Query("servers.*.enabled");
+    ASSERT_EQ(enabled.size(), 2);
+    ASSERT_TRUE(enabled[0]->AsBool());
+    ASSERT_FALSE(enabled[1]->AsBool());
+
+    auto ports = root.Query("**.ports");
+    ASSERT_EQ(ports.size(), 3);
+    ASSERT_EQ(ports[0], &root.Get("servers.first.ports"));
+    ASSERT_EQ(ports[1], &root.Get("servers.second.backup.ports"));
+    ASSERT_EQ(ports[2], &root.Get("common.ports"));
+
+    ASSERT_EQ(root.Query("servers.**.enabled").size(), 3);
+    ASSERT_EQ(root.Query("**.backup.**.ports").size(), 1);
+    ASSERT_EQ(root.Query("*").size(), 2);
+    ASSERT_TRUE(root.Query("servers.third.*").empty());
+}
+
+TEST(ParserTestSuite, ValueIndexTest) {
+    std::string data = R"(
+        [servers.first]
+        ip = "127.0.0.1"
+        ports = [100505, 10506]
+
+        [servers.second]
+        ip = "127.0.0.1"
+        ports = [10005, 10506, 10506]
+        ratio = 0.5)";
+
+    const auto root = parse(data, ParseOptions{.build_value_index = true});
+    ASSERT_TRUE(root.valid());
+    ASSERT_TRUE(root.HasValueIndex());
+    ASSERT_GT(root.ValueIndexMemoryUsage(), 0);
+
+    ASSERT_EQ(root.KeysWithValue("127.0.0.1"), (std::vector<std::string>{"servers.first.ip", "servers.second.ip"}));
+    ASSERT_EQ(root.KeysWithValue(10506), (std::vector<std::string>{"servers.first.ports", "servers.second.ports"}));
+    ASSERT_EQ(root.KeysWithValue(0.5), (std::vector<std::string>{"servers.second.ratio"}));
+    ASSERT_TRUE(root.KeysWithValue(42).empty());
+    ASSERT_TRUE(root.KeysWithValue(true).empty());
+
+    const auto unindexed = parse(data);
+    ASSERT_FALSE(unindexed.HasValueIndex());
+    ASSERT_THROW(unindexed.KeysWithValue(10506), std::runtime_error);
+
+    // Packed arrays are indexed in place, without building their Items.
+    ASSERT_EQ(root.MemoryUsage().arrays, unindexed.MemoryUsage().arrays);
+
+    const auto packed = parse(std::string(R"(
+        names = ["a", "b"]
+        ratios = [0.5, -0.0]
+        mixed = [1, ["a"], true])"), ParseOptions{.build_value_index = true});
+
+    ASSERT_EQ(packed.KeysWithValue("b"), (std::vector<std::string>{"names"}));
+    ASSERT_EQ(packed.KeysWithValue(0.0), (std::vector<std::string>{"ratios"}));
+    ASSERT_EQ(packed.KeysWithValue("a"), (std::vector<std::string>{"names", "mixed"}));
+    ASSERT_EQ(packed.KeysWithValue(true), (std::vector<std::string>{"mixed"}));
+
+    // Deep sections and arrays are indexed without recursion.
+    std::string path = "a";
+
+    for (int i = 0; i < 100000; ++i) {
+        path += ".a";
+    }
+
+    const auto deep = parse("[" + path + "]\nkey = " + std::string(100000, '[') + "7" + std::string(100000, ']'),
+                            ParseOptions{.build_value_index = true});
+
+    ASSERT_EQ(deep.KeysWithValue(7), (std::vector<std::string>{path + ".key"}));
+}
+
+TEST(ParserTestSuite, BatchTest) {
+    std::vector<std::string> storage;
+
+    for (int32_t i = 0; i < 1000; ++i) {
+        if (i % 100 == 7) {
+            storage.push_back("key = ");
+        } else if (i % 100 == 8) {
+            storage.push_back("key = 99999999999");
+        } else {
+            storage.push_back("[tenant]\nid = " + std::to_string(i) + "\nname = \"t" + std::to_string(i) + "\"");
+        }
+    }
+
+    std::vector<std::string_view> documents(storage.begin(), storage.end());
+
+    for (size_t threads: {1, 4}) {
+        const auto roots = ParseBatch(documents, {}, threads);
+
+        ASSERT_EQ(roots.size(), documents.size());
+
+        for (int32_t i = 0; i < 1000; ++i) {
+            if (i % 100 == 7 || i % 100 == 8) {
+                ASSERT_FALSE(roots[i].valid());
+            } else {
+                ASSERT_TRUE(roots[i].valid());
+                ASSERT_EQ(roots[i].Get("tenant.id").AsInt(), i);
+                ASSERT_EQ(roots[i].Get("tenant.name").AsString(), "t" + std::to_string(i));
+            }
+        }
+    }
+
+    ASSERT_TRUE(ParseBatch({}).empty());
+}
+
+TEST(ParserTestSuite, ParserContextTest) {
+    ParserContext context;
+    Parser root;
+
+    context.Parse("[a.b]\nkey = 1\nname = \"first\"", root);
+    ASSERT_TRUE(root.valid());
+    ASSERT_EQ(root.Get("a.b.key").AsInt(), 1);
+
+    context.Parse("[c]\nkey = 2", root);
+    ASSERT_TRUE(root.valid());
+    ASSERT_EQ(root.Get("c.key").AsInt(), 2);
+    ASSERT_THROW(root.Get("a"), std::runtime_error);
+
+    context.Parse("key = ", root);
+    ASSERT_FALSE(root.valid());
+
+    const auto other = context.Parse("   key   =   \"value\"   ");
+    ASSERT_TRUE(other.valid());
+    ASSERT_EQ(other.Get("key").AsString(), "value");
+
+    context.Parse("[level1.level2-1]\nkey2 = 2", root, ParseOptions{.build_value_index = true});
+    ASSERT_TRUE(root.valid());
+    ASSERT_EQ(root.KeysWithValue(2), (std::vector<std::string>{"level1.level2-1.key2"}));
+}
+
+TEST(ParserTestSuite, ResumableParseTest) {
+    std::string data = "[a]\nkey = [1, 2]  # comment\nname = \"x = y\"\n[b.c]\nflag = true";
+    ParserContext context;
+    Parser root;
+    size_t steps = 0;
+
+    context.Begin(data, root);
+
+    while (!context.Resume(1)) {
+        ++steps;
+    }
+
+    ASSERT_TRUE(root.valid());
+    ASSERT_GT(steps, 10);
+    ASSERT_EQ(root, parse(data));
+}
+
+TEST(ParserTestSuite, CopyOnWriteTest) {
+    std::string data = R"(
+        [limits]
+        rps = 100
+        [servers.first]
+        ip = "127.0.0.1"
+        ports = [1, 2]
+        [servers.second]
+        ip = "127.0.0.2")";
+
+    const auto base = parse(data, ParseOptions{.build_value_index = true});
+    auto overlay = base;
+
+    // The copy shares every section until it is changed.
+    ASSERT_EQ(&base.Get("servers.first.ip"), &overlay.Get("servers.first.ip"));
+
+    overlay.Set("servers.first.ip", std::string("10.0.0.1"));
+    overlay.Set("servers.third.ip", std::string("10.0.0.3"));
+    overlay.Set("limits", 50);
+
+    ASSERT_EQ(base.Get("servers.first.ip").AsString(), "127.0.0.1");
+    ASSERT_EQ(base.Get("limits.rps").AsInt(), 100);
+    ASSERT_EQ(base.Find("servers.third"), nullptr);
+    ASSERT_EQ(overlay.Get("servers.first.ip").AsString(), "10.0.0.1");
+    ASSERT_EQ(overlay.Get("servers.first.ports")[1].AsInt(), 2);
+    ASSERT_EQ(overlay.Get("servers.third.ip").AsString(), "10.0.0.3");
+    ASSERT_EQ(overlay.Get("limits").AsInt(), 50);
+
+    // Only the sections on the changed paths were copied.
+    ASSERT_EQ(&base.Get("servers.second.ip"), &overlay.Get("servers.second.ip"));
+    ASSERT_NE(&base.Get("servers.first.ports"), &overlay.Get("servers.first.ports"));
+
+    ASSERT_EQ(overlay, parse(std::string(R"(
+        limits = 50
+        [servers.first]
+        ip = "10.0.0.1"
+        ports = [1, 2]
+        [servers.second]
+        ip = "127.0.0.2"
+        [servers.third]
+        ip = "10.0.0.3")")));
+    ASSERT_EQ(overlay.GetRoot().Hash(), parse(std::string("limits = 50\n[servers.first]\nip = \"10.0.0.1\"\nports = [1, 2]\n[servers.second]\nip = \"127.0.0.2\"\n[servers.third]\nip = \"10.0.0.3\"")).GetRoot().Hash());
+    ASSERT_EQ(base, parse(data));
+
+    ASSERT_TRUE(base.HasValueIndex());
+    ASSERT_FALSE(overlay.HasValueIndex());
+
+    // Failed changes leave the document as it was.
+    auto copy = overlay;
+
+    ASSERT_THROW(copy.Set("limits.rps", 10), std::runtime_error);
+    ASSERT_THROW(copy.Set("servers..ip", 10), std::runtime_error);
+    ASSERT_THROW(copy.Set("bad key", 10), std::runtime_error);
+    ASSERT_THROW(copy.Set("servers.first.ip", Value()), std::runtime_error);
+    ASSERT_EQ(copy, overlay);
+}
+
+TEST(ParserTestSuite, SectionFilterTest) {
+    std::string data = R"(
+        version = 1
+        [common]
+        name = "shared"
+        [servers]
+        count = 2
+        [servers.alpha]
+        ip = "10.0.0.1"
+        [servers.beta]
+        ip = = "not checked"
+        [servers.alpha.tls]
+        enabled = true  # comment
+        [other]
+        garbage without a value
+          [common.limits]
+        rps = 10)";
+
+    ParseOptions options{.sections = {"common", "servers.alpha"}};
+    const auto root = parse(data, options);
+
+    ASSERT_TRUE(root.valid());
+    ASSERT_EQ(root, parse(std::string(R"(
+        [common]
+        name = "shared"
+        [servers.alpha]
+        ip = "10.0.0.1"
+        [servers.alpha.tls]
+        enabled = true
+        [common.limits]
+        rps = 10)")));
+    ASSERT_EQ(root.Find("version"), nullptr);
+    ASSERT_EQ(root.Find("servers.count"), nullptr);
+
+    // A resumed parse skips the same lines, even when a skip crosses the end of a step.
+    ParserContext context;
+    Parser resumed;
+
+    context.Begin(data, resumed, options);
+
+    while (!context.Resume(3)) {
+    }
+
+    ASSERT_EQ(resumed, root);
+
+    // Kept sections are still checked.
+    ASSERT_FALSE(parse(std::string("[servers.alpha]\nip = = 1\n[other]\nkey = 1"), options).valid());
+    ASSERT_FALSE(parse(data).valid());
+}
+
+TEST(ParserTestSuite, SectionFilterHeadersTest) {
+    // Skipped lines open headers wherever the scanner would: after a key or
+    // in a comment on the key side, but not in values, strings or value
+    // comments. A header in a comment also takes the next line with it.
+    std::string data = R"(
+        [other]
+        key = 1
+        foo[common]
+        name = "shared"
+        # next [servers.alpha]
+        ip = "10.0.0.1"
+        [skipped]
+        list = [1, [2]]  # [common.limits]
+        text = "[common]")";
+
+    const auto unfiltered = parse(data);
+    const auto filtered = parse(data, ParseOptions{.sections = {"common", "servers.alpha"}});
+
+    ASSERT_TRUE(unfiltered.valid());
+    ASSERT_TRUE(filtered.valid());
+    ASSERT_EQ(filtered.GetRoot().Size(), 1);
+    ASSERT_EQ(filtered.Get("common.name").AsString(), "shared");
+
+    for (const char* kept: {"common", "servers.alpha", "common.limits"}) {
+        const Item* item = filtered.Find(kept);
+        const Item* expected = unfiltered.Find(kept);
+
+        ASSERT_EQ(item == nullptr, expected == nullptr) << kept;
+
+        if (item != nullptr) {
+            ASSERT_EQ(*item, *expected) << kept;
+        }
+    }
+}
+
+TEST(ParserTestSuite, MemoryUsageTest) {
+    std::string data = "[servers.first]\nname = \"a name too long to be kept in place\"\nports = [1, 2, 3, 4, 5]\n"
+                       "mixed = [1, \"two\", [3]]\n[limits]\n";
+
+    for (int i = 0; i < 100; ++i) {
+        data += "a_rather_long_limit_key_" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    }
+
+    auto root = parse(data, ParseOptions{.build_value_index = true});
+    const auto report = root.MemoryUsage();
+
+    ASSERT_GT(report.keys, 0);
+    ASSERT_GT(report.strings, 0);
+    ASSERT_GT(report.arrays, 0);
+    ASSERT_GT(report.sections, 100 * sizeof(Item));
+    ASSERT_EQ(report.value_index, root.ValueIndexMemoryUsage());
+    ASSERT_GT(report.overhead, 0);
+    ASSERT_EQ(report.Total(), report.keys + report.strings + report.arrays + report.sections +
+                              report.value_index + report.overhead);
+
+    // Items built for indexed access to packed arrays are accounted for.
+    auto unindexed = parse(data);
+    size_t packed = unindexed.MemoryUsage().arrays;
+
+    ASSERT_EQ(unindexed.Get("servers.first.ports")[4].AsInt(), 5);
+    ASSERT_GT(unindexed.MemoryUsage().arrays, packed);
+}
+
+TEST(ParserTestSuite, DeduplicateTest) {
+    std::string data = R"(
+        [servers.first]
+        enabled = true
+        ip = "127.0.0.1"
+        ports = [100505, 10506]
+        [servers.first.tls]
+        certificate = "/etc/ssl/certs/a-path-too-long-to-be-kept-in-place.pem"
+        [servers.second]
+        enabled = true
+        ip = "127.0.0.1"
+        ports = [10005, 1006]
+        [servers.second.tls]
+        certificate = "/etc/ssl/certs/a-path-too-long-to-be-kept-in-place.pem"
+        [servers.third]
+        enabled = true
+        ip = "127.0.0.1"
+        ports = [100505, 10506]
+        [servers.third.tls]
+        certificate = "/etc/ssl/certs/a-path-too-long-to-be-kept-in-place.pem"
+        [reordered]
+        ip = "127.0.0.1"
+        enabled = true)";
+
+    auto root = parse(data, ParseOptions{.deduplicate = true});
+    const auto plain = parse(data);
+
+    ASSERT_TRUE(root.valid());
+    ASSERT_EQ(root, plain);
+    ASSERT_EQ(root.GetRoot().Hash(), plain.GetRoot().Hash());
+
+    // Identical sections share their items, wherever they are nested.
+    ASSERT_EQ(&root.Get("servers.first.ip"), &root.Get("servers.third.ip"));
+    ASSERT_EQ(&root.Get("servers.first.tls.certificate"), &root.Get("servers.second.tls.certificate"));
+    ASSERT_NE(&root.Get("servers.first.ip"), &root.Get("servers.second.ip"));
+    ASSERT_NE(&root.Get("servers.first.ip"), &plain.Get("servers.first.ip"));
+
+    // Sections holding the same items in another order keep their own.
+    ASSERT_EQ(root.Get("reordered").begin()->GetKey(), "ip");
+    ASSERT_NE(&root.Get("reordered.ip"), &root.Get("servers.first.ip"));
+
+    ASSERT_LT(root.MemoryUsage().Total(), plain.MemoryUsage().Total());
+    ASSERT_LT(root.MemoryUsage().strings, plain.MemoryUsage().strings);
+
+    // Changing one of the shared sections leaves the others as they were.
+    root.Set("servers.third.tls.certificate", std::string("other.pem"));
+
+    ASSERT_EQ(root.Get("servers.third.tls.certificate").AsString(), "other.pem");
+    ASSERT_EQ(root.Get("servers.first.tls.certificate").AsString(), plain.Get("servers.first.tls.certificate").AsString());
+    ASSERT_EQ(root.Get("servers.second.tls.certificate").AsString(), plain.Get("servers.second.tls.certificate").AsString());
+    ASSERT_EQ(root.Get("servers.third.ports")[1].AsInt(), 10506);
+}
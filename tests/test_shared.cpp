@@ -0,0 +1,195 @@
+#include <lib/parser.h>
+#include <lib/shared.h>
+
+#include <gtest/gtest.h>
+#include <optional>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace omfl;
+
+class SharedTestSuite : public testing::Test {
+protected:
+    void SetUp() override {
+        name_ = "/omfl_shared_" + std::to_string(::getpid());
+    }
+
+    void TearDown() override {
+        SharedConfig::Remove(name_);
+    }
+
+    static bool SameValue(const Item& item, const SharedItem& shared) {
+        if (item.GetType() != shared.GetType() || item.GetKey() != shared.GetKey()) {
+            return false;
+        }
+
+        switch (item.GetType()) {
+            case Type::Integer:
+                return item.AsInt() == shared.AsInt();
+            case Type::Float:
+                return item.AsFloat() == shared.AsFloat();
+            case Type::String:
+                return item.AsString() == shared.AsString();
+            case Type::Boolean:
+                return item.AsBool() == shared.AsBool();
+            default:
+                break;
+        }
+
+        if (item.Size() != shared.Size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < item.Size(); ++i) {
+            if (!SameValue(item.begin()[i], shared[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::string name_;
+};
+
+TEST_F(SharedTestSuite, PublishTest) {
+    std::string data = R"(
+        name = "shared"
+        [servers.first]
+        ip = "127.0.0.1"
+        ports = [1, 2, [3.5, "x"], true]
+        ratio = -0.25
+        [servers.second]
+        enabled = false)";
+
+    for (size_t i = 0; i < 20; ++i) {
+        data += "\n[many]\nkey-" + std::to_string(i) + " = " + std::to_string(i);
+    }
+
+    const auto root = parse(data);
+    uint64_t generation = SharedConfig::Publish(root, name_);
+    const auto config = SharedConfig::Attach(name_);
+
+    ASSERT_EQ(config.Generation(), generation);
+    ASSERT_TRUE(config.IsCurrent());
+    ASSERT_TRUE(SameValue(root.GetRoot(), config.GetRoot()));
+
+    ASSERT_EQ(config.Get("servers.first.ip").AsString(), "127.0.0.1");
+    ASSERT_EQ(config.Get("servers.first.ports")[2][1].AsString(), "x");
+    ASSERT_FALSE(config.Get("servers.first.ports")[4].IsInt());
+    ASSERT_EQ(config.Get("many.key-17").AsInt(), 17);
+    ASSERT_FALSE(config.Find("many.key-20").has_value());
+    ASSERT_FALSE(config.Find("name.value").has_value());
+    ASSERT_EQ(config.Get("servers").Find("second.enabled")->AsBoolOrDefault(true), false);
+    ASSERT_EQ(config.Get("name").AsIntOrDefault(7), 7);
+    ASSERT_THROW(config.Get("servers.third"), std::runtime_error);
+    ASSERT_THROW(config.Get("name").AsInt(), std::runtime_error);
+    ASSERT_THROW(config.Get("name").Size(), std::runtime_error);
+}
+
+TEST_F(SharedTestSuite, GenerationTest) {
+    SharedConfig::Publish(parse(std::string("version = 1")), name_);
+
+    const auto old = SharedConfig::Attach(name_);
+    uint64_t generation = SharedConfig::Publish(parse(std::string("version = 2")), name_);
+    const auto current = SharedConfig::Attach(name_);
+
+    // The old generation is unlinked, but stays readable while mapped.
+    ASSERT_FALSE(old.IsCurrent());
+    ASSERT_EQ(old.Get("version").AsInt(), 1);
+    ASSERT_TRUE(current.IsCurrent());
+    ASSERT_EQ(current.Generation(), generation);
+    ASSERT_EQ(current.Get("version").AsInt(), 2);
+
+    ASSERT_THROW(SharedConfig::Publish(parse(std::string("version =")), name_), std::runtime_error);
+
+    SharedConfig::Remove(name_);
+
+    ASSERT_THROW(SharedConfig::Attach(name_), std::runtime_error);
+    ASSERT_EQ(current.Get("version").AsInt(), 2);
+}
+
+TEST_F(SharedTestSuite, FirstPublishTest) {
+    // A control segment that holds the magic ("OMFLSHMC" in little-endian
+    // order) but no generation yet reads as nothing published.
+    int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GE(fd, 0);
+
+    char control[16] = "OMFLSHMC";
+    ASSERT_EQ(::write(fd, control, sizeof(control)), sizeof(control));
+    ::close(fd);
+
+    try {
+        SharedConfig::Attach(name_);
+        FAIL();
+    } catch (const std::runtime_error& error) {
+        ASSERT_NE(std::string(error.what()).find("Nothing is published"), std::string::npos) << error.what();
+    }
+
+    uint64_t generation = SharedConfig::Publish(parse(std::string("version = 1")), name_);
+
+    ASSERT_EQ(SharedConfig::Attach(name_).Generation(), generation);
+}
+
+TEST_F(SharedTestSuite, OtherProcessTest) {
+    SharedConfig::Publish(parse(std::string("[worker]\nthreads = 8")), name_);
+
+    pid_t child = ::fork();
+
+    if (child == 0) {
+        int threads = 0;
+
+        try {
+            threads = SharedConfig::Attach(name_).Get("worker.threads").AsInt();
+        } catch (...) {
+        }
+
+        ::_exit(threads == 8 ? 0 : 1);
+    }
+
+    int status = 0;
+
+    ASSERT_EQ(::waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST_F(SharedTestSuite, FreezeTest) {
+    std::string data = R"(
+        name = "frozen"
+        [servers.first]
+        ports = [1, 2, 3, 4, 5]
+        ratios = [0.5, -1.5, 2.25]
+        hosts = ["alpha", "beta"]
+        mixed = [1, "two", [3.5, false]])";
+
+    for (size_t i = 0; i < 100; ++i) {
+        data += "\n[limits]\na_rather_long_limit_key_" + std::to_string(i) + " = " + std::to_string(i);
+    }
+
+    const auto root = parse(data);
+    size_t arrays = root.MemoryUsage().arrays;
+    std::optional<FrozenConfig> frozen = Freeze(root);
+
+    // The parser is left as it was: packed arrays are read without being unpacked.
+    ASSERT_EQ(root.MemoryUsage().arrays, arrays);
+    ASSERT_LT(frozen->ImageSize(), root.MemoryUsage().Total());
+
+    ASSERT_EQ(frozen->Get("servers.first.ports")[4].AsInt(), 5);
+    ASSERT_EQ(frozen->Get("servers.first.ratios")[1].AsFloat(), -1.5);
+    ASSERT_EQ(frozen->Get("servers.first.hosts")[1].AsString(), "beta");
+    ASSERT_EQ(frozen->Get("servers.first.mixed")[2][0].AsFloat(), 3.5);
+    ASSERT_EQ(frozen->Get("limits.a_rather_long_limit_key_99").AsInt(), 99);
+    ASSERT_FALSE(frozen->Find("limits.a_rather_long_limit_key_100").has_value());
+    ASSERT_TRUE(SameValue(root.GetRoot(), frozen->GetRoot()));
+
+    // The image does not refer back to the parser, and moves with its owner.
+    FrozenConfig moved = std::move(*frozen);
+    frozen.reset();
+
+    ASSERT_EQ(moved.Get("name").AsString(), "frozen");
+    ASSERT_THROW(Freeze(parse(std::string("name ="))), std::runtime_error);
+}
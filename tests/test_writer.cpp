@@ -0,0 +1,151 @@
+#include <lib/writer.h>
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace omfl;
+
+class RoundTripTestSuite : public testing::TestWithParam<const char*> {
+};
+
+TEST_P(RoundTripTestSuite, RoundTripTest) {
+    const auto root = parse(std::string(GetParam()));
+    ASSERT_TRUE(root.valid());
+
+    std::string buffer;
+    WriteToBuffer(root, buffer);
+
+    const auto reparsed = parse(buffer);
+    ASSERT_TRUE(reparsed.valid()) << buffer;
+    ASSERT_EQ(root, reparsed) << buffer;
+
+    std::stringstream stream;
+    Write(root, stream);
+    ASSERT_EQ(stream.str(), buffer);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Corpus,
+    RoundTripTestSuite,
+    testing::Values(
+        "",
+        "key = \"value\"",
+        "key1 = 100500\nkey2 = -22\nkey3 = +28",
+        "key1 = 2.1\nkey2 = -3.14\nkey3 = -0.001\nkey4 = 100.0\nkey5 = 0.30000000000000004",
+        "key = \"\"\nkey1 = \"1, 2, 3 # not a comment\"",
+        "key1 = true\nkey2 = false",
+        "key1 = []\nkey2 = [1,2,3,4,5]\nkey3 = [1, -3.14, true, \"ITMO\"]\nkey4 = [[1,2],[2,[3,4,5]]]",
+        "[section1]\nkey1 = 1\nkey2 = true\n[section1]\nkey3 = \"value\"",
+        "[level1]\nkey1 = 1\n[level1.level2-1]\nkey2 = 2\n[level1.level2-2]\nkey3 = 3",
+        "[level1.level2.level3]\nkey1 = 1",
+        R"(
+        # OMFL example
+
+        [common]
+        name = "Common config"
+        description = "Some config"
+        version = 1
+
+        [servers]
+
+        [servers.first]
+        enabled = true
+        ip = "127.0.0.1"
+        ports = [ 100505, 10506 ]
+
+        [servers.second]
+        enabled = true
+        ip = "127.0.0.1"
+        ports = [ 10005, 1006 ])"
+    )
+);
+
+TEST(WriterTestSuite, BuilderTest) {
+    DocumentBuilder builder;
+
+    builder
+        .Set("title", "generated")
+        .Section("servers.first")
+        .Set("ip", "127.0.0.1")
+        .Set("enabled", true)
+        .Set("ratio", 0.5);
+
+    ValueArray ports;
+    ports.Add(Value(std::in_place_type<int32_t>, 10005), Type::Integer);
+    ports.Add(Value(std::in_place_type<int32_t>, 1006), Type::Integer);
+
+    builder.Set("ports", std::move(ports));
+
+    ASSERT_THROW(builder.Set("ip", "again"), std::runtime_error);
+    ASSERT_THROW(builder.Set("bad key", 1), std::runtime_error);
+    ASSERT_THROW(builder.Section("servers..second"), std::runtime_error);
+
+    const auto root = builder.Build();
+
+    std::string buffer;
+    WriteToBuffer(root, buffer);
+
+    ASSERT_EQ(buffer,
+        "title = \"generated\"\n"
+        "\n[servers.first]\n"
+        "ip = \"127.0.0.1\"\n"
+        "enabled = true\n"
+        "ratio = 0.5\n"
+        "ports = [10005, 1006]\n");
+
+    const auto reparsed = parse(buffer);
+    ASSERT_EQ(reparsed.Get("servers.first.ports")[1].AsInt(), 1006);
+    ASSERT_EQ(root, reparsed);
+}
+
+TEST(WriterTestSuite, EmptySectionTest) {
+    auto root = parse(std::string("[servers.first]\nip = \"127.0.0.1\""));
+
+    // The parser does not keep empty sections, so neither does Set.
+    SectionTable empty;
+    SectionTable nested;
+    nested.Insert(Item("empty", Value(std::in_place_type<SectionTable>), Type::Section));
+
+    ASSERT_THROW(root.Set("servers.second", empty), std::runtime_error);
+    ASSERT_THROW(root.Set("servers.second", nested), std::runtime_error);
+
+    SectionTable second;
+    second.Insert(Item("ip", Value(std::in_place_type<std::string>, "10.0.0.2"), Type::String));
+    root.Set("servers.second", second);
+
+    std::string buffer;
+    WriteToBuffer(root, buffer);
+
+    ASSERT_EQ(buffer, "\n[servers.first]\nip = \"127.0.0.1\"\n\n[servers.second]\nip = \"10.0.0.2\"\n");
+    ASSERT_EQ(parse(buffer), root);
+}
+
+TEST(WriterTestSuite, PackedArrayTest) {
+    const auto root = parse(std::string("a = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10]\nb = [0.5, 1.5]\nc = [\"x\", \"y\"]"));
+    size_t memory = root.MemoryUsage().Total();
+
+    std::string buffer;
+    WriteToBuffer(root, buffer);
+
+    // Packed arrays are written without building Items for their elements.
+    ASSERT_EQ(root.MemoryUsage().Total(), memory);
+    ASSERT_EQ(buffer, "a = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10]\nb = [0.5, 1.5]\nc = [\"x\", \"y\"]\n");
+}
+
+TEST(WriterTestSuite, DeepNestingTest) {
+    const size_t depth = 100000;
+    std::string array = std::string(depth, '[') + "1" + std::string(depth, ']');
+    std::string path = "a";
+
+    for (size_t i = 0; i < depth; ++i) {
+        path += ".a";
+    }
+
+    const auto root = parse("key = " + array + "\n[" + path + "]\nkey = 1");
+    ASSERT_TRUE(root.valid());
+
+    std::string buffer;
+    WriteToBuffer(root, buffer);
+
+    ASSERT_EQ(buffer, "key = " + array + "\n\n[" + path + "]\nkey = 1\n");
+}